@@ -27,45 +27,165 @@
 
 #include "AppManager.h"
 
+// How often tracking data from the other cameras is checked while the first camera is disconnected
+static const std::chrono::milliseconds kMergePollInterval(2);
+
+// How often a packet with no markers is sent while no camera is sending images
+static const std::chrono::milliseconds kStatusInterval(100);
+
 AppManager::AppManager() :
     calibration(camera),
     markerDetection(camera),
-    networkCommunication(markerDetection)
+    trackingMerger(markerDetection),
+    networkCommunication(trackingMerger),
+    isRunning(false)
 {
-    isRunning = true;
-    processingThread = std::thread(&AppManager::RunProcessingThread, this);
 }
 
 AppManager::~AppManager()
 {
     isRunning = false;
-    processingThread.join();
+    if (processingThread.joinable()) {
+        processingThread.join();
+    }
+    if (acquisitionThread.joinable()) {
+        acquisitionThread.join();
+    }
+
+    trackingMerger.RemoveAdditionalCameras();
+    additionalPipelines.clear();
 }
 
-void AppManager::RunProcessingThread()
+void AppManager::Start()
+{
+    // Called once the settings are applied. Connecting to the camera, generating the marker
+    // dictionary and loading the calibration each take a while, so they run at the same time
+    // in the background while the window is already showing.
+    // The calibration future is assigned before the processing thread that waits on it starts.
+    isRunning = true;
+    calibrationLoaded = std::async(std::launch::async, &AppManager::LoadCalibration, this);
+    acquisitionThread = std::thread(&AppManager::RunAcquisitionThread, this);
+    processingThread = std::thread(&AppManager::RunProcessingThread, this);
+}
+
+void AppManager::LoadCalibration()
+{
+    calibration.LoadCalibration();
+    startupTimer.Mark("Calibration loaded");
+}
+
+void AppManager::RunAcquisitionThread()
 {
+    // Acquisition runs on its own thread so capture overlaps with processing.
+    // Frames are published to the camera's mailbox and processing always takes the newest one.
+    // Without a camera, Run() waits between attempts to reconnect.
+    bool isCameraStarted = false;
     while (isRunning) {
         camera.Run();
 
-        if (camera.GetIsConnected()) {
-            if (mode == AppMode::Calibration) {
+        if (!isCameraStarted && camera.GetIsConnected()) {
+            startupTimer.Mark("Camera connected");
+            isCameraStarted = true;
+        }
+    }
+}
+
+void AppManager::RunProcessingThread()
+{
+    // The marker dictionary is generated while the camera is still connecting.
+    // Tracking waits for the saved calibration so markers don't jump once it is applied.
+    markerDetection.UpdateDictionary();
+    startupTimer.Mark("Marker dictionary generated");
+    if (calibrationLoaded.valid()) {
+        calibrationLoaded.wait();
+    }
+
+    bool isMarkerTracked = false;
+    std::chrono::steady_clock::time_point nextStatusTime;
+    while (isRunning) {
+        // Clients get the health of the camera that is worst off, so they hear about any camera that stopped
+        networkCommunication.UpdateCameraHealth(GetWorstCameraHealth());
+
+        // Calibration and detection on the first camera need the first camera, but tracking data
+        // is sent while any camera is connected so the other cameras keep tracking without it
+        bool isCameraConnected = camera.GetIsConnected();
+        if (isCameraConnected && mode == AppMode::Calibration) {
+            markerDetection.Pause();
+            networkCommunication.Pause();
+            calibration.Run();
+        }
+        else if (mode == AppMode::Tracking && (isCameraConnected || GetIsAdditionalCameraConnected())) {
+            if (isCameraConnected) {
+                markerDetection.Run();
+            }
+            else {
+                // The other cameras detect on their own threads, so there is no frame to wait for here
                 markerDetection.Pause();
-                networkCommunication.Pause();
-                calibration.Run();
+                std::this_thread::sleep_for(kMergePollInterval);
             }
-            else if (mode == AppMode::Tracking) {
-                markerDetection.Run();
-                networkCommunication.Run();
-                calibration.Pause();
+            networkCommunication.Run();
+            calibration.Pause();
+
+            if (!isMarkerTracked && markerDetection.GetIsDetected()) {
+                startupTimer.Mark("First marker tracked");
+                isMarkerTracked = true;
             }
         }
         else {
             markerDetection.Pause();
             networkCommunication.Pause();
             calibration.Pause();
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            std::this_thread::sleep_for(kStatusInterval);
+        }
+
+        // Without tracking data a status packet still goes out while no camera is sending images,
+        // including a camera that is connected but stalled
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now >= nextStatusTime && !GetIsAnyCameraStreaming()) {
+            networkCommunication.SendStatus();
+            nextStatusTime = now + kStatusInterval;
+        }
+    }
+}
+
+bool AppManager::GetIsAdditionalCameraConnected()
+{
+    std::lock_guard<std::mutex> lockGuard(pipelinesMutex);
+    for (int i = 0; i < additionalPipelines.size(); i++) {
+        if (additionalPipelines[i]->camera.GetIsConnected()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CameraHealth AppManager::GetWorstCameraHealth()
+{
+    // The health values are ordered from best to worst
+    CameraHealth worstHealth = camera.GetHealth();
+    std::lock_guard<std::mutex> lockGuard(pipelinesMutex);
+    for (int i = 0; i < additionalPipelines.size(); i++) {
+        CameraHealth health = additionalPipelines[i]->camera.GetHealth();
+        if (health > worstHealth) {
+            worstHealth = health;
+        }
+    }
+    return worstHealth;
+}
+
+bool AppManager::GetIsAnyCameraStreaming()
+{
+    if (camera.GetHealth() == CameraHealth::Streaming) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lockGuard(pipelinesMutex);
+    for (int i = 0; i < additionalPipelines.size(); i++) {
+        if (additionalPipelines[i]->camera.GetHealth() == CameraHealth::Streaming) {
+            return true;
         }
     }
+    return false;
 }
 
 AppMode AppManager::GetMode()
@@ -78,3 +198,78 @@ void AppManager::SetMode(AppMode mode)
     this->mode = mode;
 }
 
+
+FrameStatistics AppManager::GetFrameStatistics()
+{
+    FrameStatistics statistics;
+    statistics.camera = camera.GetStatistics();
+    statistics.numIncompleteImages = camera.GetNumIncompleteImages();
+    statistics.numSkippedImages = camera.GetNumSkippedImages();
+    statistics.numStalls = camera.GetNumStalls();
+    statistics.detection = markerDetection.GetStatistics();
+    statistics.network = networkCommunication.GetStatistics();
+    return statistics;
+}
+
+void AppManager::ResetFrameStatistics()
+{
+    camera.ResetStatistics();
+    markerDetection.ResetStatistics();
+    networkCommunication.ResetStatistics();
+}
+
+void AppManager::UpdateDetectorParameters(DetectorParameterData detectorParameters)
+{
+    markerDetection.UpdateDetectorParameters(detectorParameters);
+
+    std::lock_guard<std::mutex> lockGuard(pipelinesMutex);
+    this->detectorParameters = detectorParameters;
+    for (int i = 0; i < additionalPipelines.size(); i++) {
+        additionalPipelines[i]->markerDetection.UpdateDetectorParameters(detectorParameters);
+    }
+}
+
+void AppManager::UpdateCameraHomography(cv::Matx33d homography)
+{
+    trackingMerger.UpdateCameraHomography(0, homography);
+}
+
+void AppManager::UpdateAdditionalCameras(FrameSourceData frameSourceData, std::vector<CameraPipelineData> additionalCameras)
+{
+    std::lock_guard<std::mutex> lockGuard(pipelinesMutex);
+
+    // Each camera uses the same kind of frame source as the first one
+    std::vector<FrameSourceData> frameSources;
+    for (int i = 0; i < additionalCameras.size(); i++) {
+        FrameSourceData cameraFrameSourceData = frameSourceData;
+        cameraFrameSourceData.serialNumber = additionalCameras[i].serialNumber;
+        cameraFrameSourceData.otherSerialNumbers.clear();
+        if (frameSourceData.type != FrameSourceType::Spinnaker) {
+            cameraFrameSourceData.path = additionalCameras[i].serialNumber;
+        }
+        frameSources.push_back(cameraFrameSourceData);
+    }
+
+    // Keep the pipelines running if the same cameras are listed in the same order
+    bool isSameCameras = (additionalCameras.size() == this->additionalCameras.size());
+    for (int i = 0; isSameCameras && i < additionalCameras.size(); i++) {
+        isSameCameras = (additionalCameras[i].serialNumber == this->additionalCameras[i].serialNumber);
+    }
+
+    if (isSameCameras) {
+        for (int i = 0; i < additionalPipelines.size(); i++) {
+            additionalPipelines[i]->camera.UpdateFrameSource(frameSources[i]);
+            trackingMerger.UpdateCameraHomography(i + 1, additionalCameras[i].homography);
+        }
+    }
+    else {
+        // The merger stops reading from the old pipelines before they are destroyed
+        trackingMerger.RemoveAdditionalCameras();
+        additionalPipelines.clear();
+        for (int i = 0; i < additionalCameras.size(); i++) {
+            additionalPipelines.push_back(std::make_unique<CameraPipeline>(frameSources[i], detectorParameters));
+            trackingMerger.AddCamera(additionalPipelines.back()->markerDetection, additionalCameras[i].homography);
+        }
+    }
+    this->additionalCameras = additionalCameras;
+}
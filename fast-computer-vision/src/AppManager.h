@@ -31,6 +31,11 @@
 #include "Calibration.h"
 #include "MarkerDetection.h"
 #include "NetworkCommunication.h"
+#include "TrackingMerger.h"
+#include "CameraPipeline.h"
+#include "CameraPipelineData.h"
+#include "StartupTimer.h"
+#include <future>
 #include <QImage>
 #include <QPixmap>
 #include <QObject>
@@ -44,12 +49,20 @@ class AppManager : public QObject
 public:
 	AppManager();
     ~AppManager();
+    void Start();
 
     AppMode GetMode();
+    FrameStatistics GetFrameStatistics();
+    void ResetFrameStatistics();
+    void UpdateDetectorParameters(DetectorParameterData detectorParameters);
+    void UpdateCameraHomography(cv::Matx33d homography);
+    void UpdateAdditionalCameras(FrameSourceData frameSourceData, std::vector<CameraPipelineData> additionalCameras);
 
+    StartupTimer startupTimer;
     Camera camera;
     Calibration calibration;
     MarkerDetection markerDetection;
+    TrackingMerger trackingMerger;
     NetworkCommunication networkCommunication;
 
 public slots:
@@ -59,7 +72,22 @@ private:
     enum AppMode mode;
     bool isRunning;
 
+    std::thread acquisitionThread;
 	std::thread processingThread;
+    void RunAcquisitionThread();
     void RunProcessingThread();
+    bool GetIsAdditionalCameraConnected();
+    CameraHealth GetWorstCameraHealth();
+    bool GetIsAnyCameraStreaming();
+
+    // The saved calibration is loaded in the background while the camera connects
+    std::future<void> calibrationLoaded;
+    void LoadCalibration();
+
+    // Cameras after the first each run in their own pipeline
+    std::vector<std::unique_ptr<CameraPipeline>> additionalPipelines;
+    std::vector<CameraPipelineData> additionalCameras;
+    DetectorParameterData detectorParameters;
+    std::mutex pipelinesMutex;
 };
 
@@ -0,0 +1,129 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "Benchmark.h"
+#include "ExecutionTimer.h"
+#include "MarkerSearch.h"
+#include "SyntheticFrameSource.h"
+#include <functional>
+
+static const int kNumBenchmarkRuns = 50;
+
+// Marker detection takes much longer than the other kernels, so it is run fewer times
+static const int kNumDetectionRuns = 5;
+static const int kNumBenchmarkMarkers = 48;
+
+// Average time of one run in milliseconds, after one run to warm up
+static double MeasureAverageTime(std::function<void()> function, int numRuns = kNumBenchmarkRuns)
+{
+    function();
+
+    ExecutionTimer timer;
+    timer.Start();
+    for (int i = 0; i < numRuns; i++) {
+        function();
+    }
+    timer.Stop();
+    return timer.duration / numRuns;
+}
+
+static void BenchmarkTiledDetection()
+{
+    // One frame of the synthetic scene, which has markers spread over the whole image
+    FrameSourceData frameSourceData;
+    frameSourceData.type = FrameSourceType::Synthetic;
+    frameSourceData.pacing = FramePacing::AsFastAsPossible;
+    frameSourceData.markerDictionarySize = kNumBenchmarkMarkers;
+    SyntheticFrameSource frameSource(frameSourceData);
+    SensorGeometry sensorGeometry;
+    SourceImage sourceImage;
+    if (!frameSource.Open() || !frameSource.ConfigureReadoutMode(ReadoutMode::Full, sensorGeometry) ||
+        !frameSource.Grab(sourceImage, true))
+    {
+        std::cout << "BenchmarkTiledDetection() Error: Could not generate the scene" << std::endl;
+        return;
+    }
+    cv::Mat sceneImage = sourceImage.image.clone();
+    frameSource.Close();
+
+    cv::Ptr<cv::aruco::Dictionary> markerDictionary = cv::aruco::generateCustomDictionary(
+        frameSourceData.markerDictionarySize, frameSourceData.markerNumBits);
+    cv::Ptr<cv::aruco::DetectorParameters> markerParameters = cv::aruco::DetectorParameters::create();
+    cv::aruco::ArucoDetector arucoDetector(markerDictionary, markerParameters);
+    std::vector<std::vector<cv::Point2f>> markerCorners, rejectedCandidates;
+    std::vector<int> markerIds;
+    cv::Mat downscaledImage;
+
+    // The tiles overlap by a little more than the largest marker found in the whole image
+    arucoDetector.detectMarkers(sceneImage, markerCorners, markerIds);
+    double maxMarkerSize = 0;
+    for (int i = 0; i < markerCorners.size(); i++) {
+        maxMarkerSize = std::max(maxMarkerSize, cv::arcLength(markerCorners[i], true) / 4);
+    }
+    int tileMarkerSize = std::ceil(maxMarkerSize * 1.1);
+
+    std::cout << "Marker detection " << sceneImage.cols << " x " << sceneImage.rows << " grayscale, "
+        << kNumBenchmarkMarkers << " markers, tiles overlap " << tileMarkerSize << " pixels" << std::endl;
+
+    // Thread counts double up to the number of cores, which is always included
+    int defaultNumThreads = cv::getNumThreads();
+    int numCores = cv::getNumberOfCPUs();
+    std::vector<int> threadCounts;
+    for (int numThreads = 1; numThreads < numCores; numThreads *= 2) {
+        threadCounts.push_back(numThreads);
+    }
+    threadCounts.push_back(numCores);
+
+    for (int i = 0; i < threadCounts.size(); i++) {
+        int numThreads = threadCounts[i];
+        cv::setNumThreads(numThreads);
+
+        int numWholeMarkers = 0;
+        double wholeTime = MeasureAverageTime([&]() {
+            DetectMarkersPyramid(arucoDetector, sceneImage, 0, markerCorners, markerIds, rejectedCandidates, downscaledImage);
+            numWholeMarkers = markerIds.size();
+        }, kNumDetectionRuns);
+
+        int numTiledMarkers = 0;
+        double tiledTime = MeasureAverageTime([&]() {
+            DetectMarkersTiled(arucoDetector, sceneImage, 0, tileMarkerSize,
+                markerParameters->minMarkerPerimeterRate, markerCorners, markerIds);
+            numTiledMarkers = markerIds.size();
+        }, kNumDetectionRuns);
+
+        int numTiles = GetDetectionTiles(sceneImage.size(), tileMarkerSize, numThreads).size();
+        std::cout << "    " << numThreads << " threads:" << std::endl;
+        std::cout << "        Whole image: " << wholeTime << " ms, " << numWholeMarkers << " markers" << std::endl;
+        std::cout << "        " << numTiles << " tiles: " << tiledTime << " ms, " << numTiledMarkers << " markers" << std::endl;
+    }
+    cv::setNumThreads(defaultNumThreads);
+}
+
+void RunBenchmarks()
+{
+    BenchmarkTiledDetection();
+}
@@ -33,8 +33,13 @@ enum class CalibrationType {None, Preview, Saved};
 struct CalibrationData
 {
     CalibrationType type = CalibrationType::None;
+    cv::Size imageSize;
     cv::Mat distortionCoefficients;
     cv::Mat cameraMatrix;
     cv::Mat distortMap;
     cv::Mat undistortMap;
+
+    // Where camera pixels end up in the undistorted image, on a coarse grid of camera pixels,
+    // so single points can be undistorted without remapping the whole image
+    cv::Mat undistortPointMap;
 };
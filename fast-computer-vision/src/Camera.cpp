@@ -26,43 +26,83 @@
 //=============================================================================
 
 #include "Camera.h"
+#include "Calibration.h"
+
+// Reconnection is tried right after the camera is lost, then after each of these delays doubling
+static const std::chrono::milliseconds kMinReconnectDelay(10);
+static const std::chrono::milliseconds kMaxReconnectDelay(1000);
 
 Camera::Camera() :
     isConnected(false),
+    reconnectDelay(0),
+    disconnectTime(std::chrono::steady_clock::now()),
+    isDeviceArrived(false),
+    isFrameSourceChanged(true),
+    framePool(4, cv::Size(kDefaultImageWidth, kDefaultImageHeight), CV_8UC1),
+    resolution(kDefaultImageWidth, kDefaultImageHeight),
     currentFrameNumber(0),
+    timestampOffset(0),
+    isTimestampOffsetValid(false),
+    numIncompleteImages(0),
+    numSkippedImages(0),
+    stallTimeoutSeconds(2),
+    health(CameraHealth::Disconnected),
+    numStalls(0),
     gamma(0.5),
+    isFrameSourceOpen(false),
     isApplyCalibration(false),
-    isApplyCalibrationPreview(false)
+    isApplyCalibrationPreview(false),
+    calibrationVersion(0),
+    scaledCalibrationSource(NULL),
+    scaledCalibrationVersion(0),
+    readoutMode(ReadoutMode::Full),
+    activeReadoutMode(ReadoutMode::Full),
+    isGrayscale(false),
+    isPointUndistortion(false),
+    isUseSensorRegion(false),
+    isApplySensorRegion(false),
+    sensorRegionArea(0, 0, 1, 1),
+    sensorSize(kDefaultImageWidth, kDefaultImageHeight),
+    sensorOffsetIncrement(1, 1),
+    sensorSizeIncrement(1, 1),
+    sensorMinimumSize(1, 1),
+    sensorRegion(0, 0, kDefaultImageWidth, kDefaultImageHeight),
+    regionMapCalibration(NULL),
+    regionMapCalibrationVersion(0)
 {
-    // Retrieve singleton reference to system object
-    spinnakerSystem = Spinnaker::System::GetInstance();
-
-    // Print out current library version
-    const Spinnaker::LibraryVersion spinnakerLibraryVersion = spinnakerSystem->GetLibraryVersion();
-    std::cout << "Spinnaker library version: "
-        << spinnakerLibraryVersion.major << "."
-        << spinnakerLibraryVersion.minor << "."
-        << spinnakerLibraryVersion.type << "."
-        << spinnakerLibraryVersion.build << std::endl << std::endl;
-
-    pCamera = NULL;
-
-    outputImage = cv::Mat(kImageHeight, kImageWidth, CV_8UC3);
+    // The frame source is created by the first Run() on the acquisition thread, because opening
+    // the camera SDK can take a while and the settings may still change which source to use
 }
 
 Camera::~Camera()
 {
     Disconnect();
-    spinnakerSystem->ReleaseInstance();
 }
 
 void Camera::Run()
 {
+    // A new frame source replaces the current one between frames
+    {
+        std::lock_guard<std::mutex> lockGuard(frameSourceMutex);
+        if (isFrameSourceChanged) {
+            if (isConnected) {
+                isConnected = false;
+                Disconnect();
+            }
+            std::lock_guard<std::mutex> parametersLockGuard(cameraParametersMutex);
+            isFrameSourceOpen = false;
+            frameSource = CreateFrameSource(frameSourceData);
+            frameSource->SetDeviceArrivalCallback([this]() { NotifyDeviceArrival(); });
+            isFrameSourceChanged = false;
+            reconnectDelay = std::chrono::milliseconds(0);
+        }
+    }
+
     if (isConnected) {
         GetFrame();
     }
     else {
-        Connect();
+        Reconnect();
     }
 }
 
@@ -71,14 +111,21 @@ bool Camera::GetIsConnected()
     return isConnected;
 }
 
-void Camera::CopyImageTo(cv::Mat& destinationImage)
+std::shared_ptr<const FrameData> Camera::GetOutputFrame()
+{
+    return outputFrameMailbox.Peek();
+}
+
+std::shared_ptr<const FrameData> Camera::WaitForOutputFrame(unsigned int& sequenceNumber, int timeoutMs)
 {
-    outputImage.copyTo(destinationImage);
+    return outputFrameMailbox.WaitForNewer(sequenceNumber, timeoutMs);
 }
 
 cv::Size Camera::GetResolution()
 {
-    return outputImage.size();
+    // The resolution only changes with the readout mode, which is set on the acquisition thread
+    std::lock_guard<std::mutex> lockGuard(cameraParametersMutex);
+    return resolution;
 }
 
 unsigned int Camera::GetFrameNumber()
@@ -91,6 +138,49 @@ double Camera::GetFrameRate()
     return frameRateTimer.frameRate;
 }
 
+StageStatistics Camera::GetStatistics()
+{
+    return frameCounter.GetStatistics();
+}
+
+FlightRecorder& Camera::GetFlightRecorder()
+{
+    return flightRecorder;
+}
+
+ExposureController& Camera::GetExposureController()
+{
+    return exposureController;
+}
+
+long long Camera::GetNumIncompleteImages()
+{
+    return numIncompleteImages;
+}
+
+long long Camera::GetNumSkippedImages()
+{
+    return numSkippedImages;
+}
+
+long long Camera::GetNumStalls()
+{
+    return numStalls;
+}
+
+CameraHealth Camera::GetHealth()
+{
+    return health;
+}
+
+void Camera::ResetStatistics()
+{
+    frameCounter.Reset();
+    numIncompleteImages = 0;
+    numSkippedImages = 0;
+    numStalls = 0;
+}
+
 void Camera::Calibrate(CalibrationData calibrationData)
 {
     if (calibrationData.type == CalibrationType::Preview) {
@@ -99,6 +189,7 @@ void Camera::Calibrate(CalibrationData calibrationData)
     else if (calibrationData.type == CalibrationType::Saved) {
         this->calibrationData = calibrationData;
     }
+    calibrationVersion++;
 }
 
 void Camera::ToggleCalibrationPreview(bool isOn)
@@ -116,236 +207,540 @@ void Camera::UpdateGamma(double gamma)
     std::lock_guard<std::mutex> lockGuard(cameraParametersMutex);
     this->gamma = gamma;
 
-    if (isConnected) {
-        try {
-            pCamera->Gamma.SetValue(gamma);
-        }
-        catch (Spinnaker::Exception& exception) {
-            std::cout << "UpdateGamma() Error: " << exception.what() << std::endl;
-        }
+    if (isFrameSourceOpen) {
+        frameSource->ConfigureGamma(gamma);
     }
 }
 
-void Camera::UpdateRotation(bool isRotate)
+void Camera::ToggleGrayscale(bool isOn)
 {
-    this->isRotate = isRotate;
+    isGrayscale = isOn;
 }
 
-void Camera::ToggleRotation(bool isOn)
+void Camera::TogglePointUndistortion(bool isOn)
 {
-    isApplyRotation = isOn;
+    isPointUndistortion = isOn;
 }
 
-void Camera::Connect()
+void Camera::UpdateSensorRegion(cv::Rect2d trackingArea)
 {
-    frameRateTimer.Reset();
+    std::lock_guard<std::mutex> lockGuard(sensorRegionMutex);
+    sensorRegionArea = trackingArea;
+}
+
+void Camera::UpdateUseSensorRegion(bool isUseSensorRegion)
+{
+    this->isUseSensorRegion = isUseSensorRegion;
+}
+
+void Camera::ToggleSensorRegion(bool isOn)
+{
+    isApplySensorRegion = isOn;
+}
 
-    cv::Mat zeros = cv::Mat::zeros(outputImage.size(), outputImage.type());
-    zeros.copyTo(outputImage);
+void Camera::UpdateReadoutMode(ReadoutMode readoutMode)
+{
+    this->readoutMode = readoutMode;
+}
 
-    // Retrieve list of cameras from the system
-    cameraList = spinnakerSystem->GetCameras();
-    unsigned int numCameras = cameraList.GetSize();
+void Camera::UpdateStallTimeout(double seconds)
+{
+    stallTimeoutSeconds = seconds;
+}
 
-    // Fail if no cameras are detected
-    if (numCameras < 1) {
+void Camera::UpdateFrameSource(FrameSourceData frameSourceData)
+{
+    std::lock_guard<std::mutex> lockGuard(frameSourceMutex);
+
+    // Don't reconnect if nothing changed
+    if (frameSourceData.type == this->frameSourceData.type &&
+        frameSourceData.pacing == this->frameSourceData.pacing &&
+        frameSourceData.path == this->frameSourceData.path &&
+        frameSourceData.serialNumber == this->frameSourceData.serialNumber &&
+        frameSourceData.otherSerialNumbers == this->frameSourceData.otherSerialNumbers &&
+        frameSourceData.frameRate == this->frameSourceData.frameRate &&
+        frameSourceData.imageSize == this->frameSourceData.imageSize &&
+        frameSourceData.markerDictionarySize == this->frameSourceData.markerDictionarySize &&
+        frameSourceData.markerNumBits == this->frameSourceData.markerNumBits &&
+        frameSourceData.isSyntheticBayer == this->frameSourceData.isSyntheticBayer)
+    {
         return;
     }
 
-    // Select the first camera
-    // There should never be more than one camera, but if there is just try the first one
-    pCamera = cameraList.GetByIndex(0);
+    this->frameSourceData = frameSourceData;
+    isFrameSourceChanged = true;
+}
 
-    try {
-        // Retrieve TL device nodemap and print device information
-        Spinnaker::GenApi::INodeMap& nodeMapTLDevice = pCamera->GetTLDeviceNodeMap();
-        PrintDeviceInfo(nodeMapTLDevice);
-
-        // Initialize camera
-        pCamera->Init();
-
-        {
-            std::lock_guard<std::mutex> lockGuard(cameraParametersMutex);
-            std::cout << std::endl << std::endl << "*** CAMERA CONFIGURATION ***" << std::endl << std::endl;
-
-            // Retrieve stream parameters device nodemap
-            Spinnaker::GenApi::INodeMap& streamNodeMap = pCamera->GetTLStreamNodeMap();
-            // Set buffer handling mode
-            Spinnaker::GenApi::CEnumerationPtr ptrHandlingMode = streamNodeMap.GetNode("StreamBufferHandlingMode");
-            Spinnaker::GenApi::CEnumEntryPtr ptrHandlingModeEntry = ptrHandlingMode->GetCurrentEntry();
-            ptrHandlingModeEntry = ptrHandlingMode->GetEntryByName("NewestOnly");
-            ptrHandlingMode->SetIntValue(ptrHandlingModeEntry->GetValue());
-            std::cout << "Buffer Handling Mode: " << ptrHandlingModeEntry->GetDisplayName() << std::endl;
-
-            // Set other camera parameters
-            pCamera->AcquisitionMode.SetValue(Spinnaker::AcquisitionMode_Continuous);
-            pCamera->AcquisitionFrameRateEnable.SetValue(false);
-            pCamera->Gamma.SetValue(gamma);
-        }
+cv::Rect Camera::AlignSensorRegion(cv::Rect region, cv::Size sensorSize,
+    cv::Size offsetIncrement, cv::Size sizeIncrement, cv::Size minimumSize)
+{
+    // Grow the region outward until the offset and size are multiples of the increments
+    // the camera accepts, then shift it back onto the sensor if it grew past the edge.
+    cv::Rect sensorArea(cv::Point(0, 0), sensorSize);
+    region &= sensorArea;
+    if (region.empty()) {
+        return sensorArea;
+    }
+
+    int left = (region.x / offsetIncrement.width) * offsetIncrement.width;
+    int top = (region.y / offsetIncrement.height) * offsetIncrement.height;
+
+    int width = region.x + region.width - left;
+    int height = region.y + region.height - top;
+    width = ((width + sizeIncrement.width - 1) / sizeIncrement.width) * sizeIncrement.width;
+    height = ((height + sizeIncrement.height - 1) / sizeIncrement.height) * sizeIncrement.height;
+    width = std::min(std::max(width, minimumSize.width), sensorSize.width);
+    height = std::min(std::max(height, minimumSize.height), sensorSize.height);
 
-        // Begin acquiring images
-        pCamera->BeginAcquisition();
-        std::cout << std::endl << std::endl << "*** CAMERA ACQUISITION ***" << std::endl << std::endl;
-        std::cout << "Acquiring images..." << std::endl;
+    if (left + width > sensorSize.width) {
+        left = ((sensorSize.width - width) / offsetIncrement.width) * offsetIncrement.width;
     }
-    catch (Spinnaker::Exception& exception) {
-        std::cout << "Connect() Error: " << exception.what() << std::endl;
-        Disconnect();
+    if (top + height > sensorSize.height) {
+        top = ((sensorSize.height - height) / offsetIncrement.height) * offsetIncrement.height;
     }
 
+    return cv::Rect(left, top, width, height);
+}
+
+void Camera::Connect()
+{
+    frameRateTimer.Reset();
+
+    outputFrameMailbox.Clear();
+    isTimestampOffsetValid = false;
+    frameCounter.Restart();
+    exposureController.Reset();
+
+    {
+        std::lock_guard<std::mutex> lockGuard(cameraParametersMutex);
+        if (!frameSource->Open()) {
+            return;
+        }
+        isFrameSourceOpen = true;
+        frameSource->ConfigureGamma(gamma);
+    }
+
+    // Set binning or decimation, which also reads out the full sensor
+    if (!ConfigureReadoutMode()) {
+        std::lock_guard<std::mutex> lockGuard(cameraParametersMutex);
+        isFrameSourceOpen = false;
+        frameSource->Close();
+        return;
+    }
+
+    // The watchdog gives the camera the whole timeout to send its first frame
+    lastFrameTime = std::chrono::steady_clock::now();
     isConnected = true;
     emit CameraConnected();
-    return;
 }
 
 void Camera::Disconnect()
 {
-    if (pCamera != NULL) {
-        try {
-            // Release image pointer
-            if (pImage->IsInUse()) {
-                pImage->Release();
-            }
-            pImage = NULL;
+    {
+        std::lock_guard<std::mutex> lockGuard(cameraParametersMutex);
+        if (frameSource == nullptr) {
+            return;
+        }
+        isFrameSourceOpen = false;
+        frameSource->Close();
+    }
 
-            // End acquisition
-            if (pCamera->IsStreaming()) {
-                pCamera->EndAcquisition();
-            }
+    disconnectTime = std::chrono::steady_clock::now();
+    reconnectDelay = std::chrono::milliseconds(0);
+    health = CameraHealth::Disconnected;
 
-            // Deinitialize camera
-            if (pCamera->IsInitialized()) {
-                pCamera->DeInit();
-            }
-        }
-        catch (Spinnaker::Exception& exception) {
-            std::cout << "Disconnect() Error: " << exception.what() << std::endl;
-        }
+    emit CameraDisconnected();
+}
 
-        pCamera = NULL;
+void Camera::Reconnect()
+{
+    // This runs on the acquisition thread, which has nothing else to do without a camera.
+    // Detection, the network and any other cameras keep running on their own threads.
+    {
+        std::unique_lock<std::mutex> lock(reconnectMutex);
+        reconnectCondition.wait_for(lock, reconnectDelay, [this] { return isDeviceArrived; });
+        isDeviceArrived = false;
     }
 
-    try {
-        // Clear camera list before releasing system
-        cameraList.Clear();
+    Connect();
+
+    if (isConnected) {
+        long long downtime = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - disconnectTime).count();
+        std::cout << "Camera connected after " << downtime << " ms" << std::endl;
     }
-    catch (Spinnaker::Exception& exception) {
-        std::cout << "Disconnect() Error: " << exception.what() << std::endl;
+    else {
+        reconnectDelay = std::min(std::max(reconnectDelay * 2, kMinReconnectDelay), kMaxReconnectDelay);
+        health = CameraHealth::Disconnected;
     }
+}
 
-    emit CameraDisconnected();
+void Camera::NotifyDeviceArrival()
+{
+    {
+        std::lock_guard<std::mutex> lockGuard(reconnectMutex);
+        isDeviceArrived = true;
+    }
+    reconnectCondition.notify_one();
 }
 
 void Camera::GetFrame()
 {
-    try {
-        if (pCamera == NULL) {
-            isConnected = false;
-            emit CameraDisconnected();
+    if (!frameSource->IsOpen()) {
+        isConnected = false;
+        health = CameraHealth::Disconnected;
+        emit CameraDisconnected();
+        return;
+    }
+
+    // A stream can stop without an error, so the source still looks open and every grab just
+    // times out. Acquisition is restarted when no new frame has come out for too long, so
+    // a frozen camera doesn't look connected.
+    double stallTimeout = stallTimeoutSeconds;
+    std::chrono::duration<double> timeSinceFrame = std::chrono::steady_clock::now() - lastFrameTime;
+    if (stallTimeout > 0 && timeSinceFrame.count() > stallTimeout) {
+        std::cout << "Camera stalled: No new frame for " << std::fixed << std::setprecision(1)
+            << timeSinceFrame.count() << std::defaultfloat << " s, restarting acquisition" << std::endl;
+        numStalls++;
+        isConnected = false;
+        Disconnect();
+        health = CameraHealth::Stalled;
+        return;
+    }
+
+    // Binning or decimation changes the size of the sensor
+    if (readoutMode.load() != activeReadoutMode) {
+        if (!ConfigureReadoutMode()) {
             return;
         }
-        if (!pCamera->IsInitialized() || !pCamera->IsStreaming()) {
-            isConnected = false;
-            emit CameraDisconnected();
-            return;
+    }
+
+    // Select the calibration to apply to this frame
+    // Calibration maps are scaled if they were made for a different image size.
+    const CalibrationData* activeCalibration = NULL;
+    if (isApplyCalibrationPreview && calibrationPreviewData.type == CalibrationType::Preview) {
+        activeCalibration = &calibrationPreviewData;
+    }
+    else if (isApplyCalibration && calibrationData.type == CalibrationType::Saved) {
+        activeCalibration = &calibrationData;
+    }
+    if (activeCalibration != NULL && activeCalibration->distortMap.size() != sensorSize) {
+        activeCalibration = GetScaledCalibration(activeCalibration);
+    }
+
+    // With point undistortion the saved calibration isn't applied to the image. Detection
+    // undistorts the few marker corners it finds instead, which is far cheaper than remapping
+    // every pixel. The calibration preview always remaps so the result can be seen.
+    bool isUndistortPoints = isPointUndistortion && activeCalibration != NULL &&
+        activeCalibration->type == CalibrationType::Saved;
+    bool isRemapImage = (activeCalibration != NULL && !isUndistortPoints);
+
+    // Only read out the part of the sensor that is needed. This reconfigures the source
+    // whenever the tracking area or calibration changes the region.
+    // The region maps are built even without remapping to find which part of the sensor
+    // the tracking area comes from.
+    cv::Rect outputRegion = GetRequestedOutputRegion();
+    UpdateRegionMaps(activeCalibration, outputRegion);
+    if (regionMapSensorRegion != sensorRegion && !ConfigureSensorRegion(regionMapSensorRegion)) {
+        // The maps were built for the region the source rejected, so they are rebuilt for the full sensor
+        UpdateRegionMaps(activeCalibration, GetRequestedOutputRegion());
+    }
+
+    // Exposure changes from the auto exposure are made between frames
+    CameraExposure exposure;
+    if (exposureController.GetNewExposure(exposure, currentFrameNumber)) {
+        if (frameSource->ConfigureExposure(exposure)) {
+            exposureController.SetAppliedExposure(exposure, currentFrameNumber);
+        }
+        else {
+            exposureController.SetExposureRejected(currentFrameNumber);
         }
     }
-    catch (Spinnaker::Exception& exception) {
-        std::cout << "GetFrame() Camera Error: " << exception.what() << std::endl;
 
-        isConnected = false;
-        emit CameraDisconnected();
+    // Retrieve next image from the frame source
+    // The mode is read once so the whole frame is built the same way if it changes meanwhile.
+    bool isGrayscaleFrame = isGrayscale;
+    SourceImage sourceImage;
+    if (!frameSource->Grab(sourceImage, isGrayscaleFrame)) {
+        if (sourceImage.isIncomplete) {
+            numIncompleteImages++;
+        }
         return;
     }
+    std::chrono::system_clock::time_point receiveTime = std::chrono::system_clock::now();
 
-    try {
-        // Retrieve next received image
-        pImage = pCamera->GetNextImage();
+    // Gaps in the device's frame IDs are frames that were captured but never arrived
+    if (sourceImage.frameId >= 0) {
+        frameCounter.Count(sourceImage.frameId);
+    }
 
-        executionTimer.Start();
-        bool isImageReady = !(pImage->IsIncomplete() || pImage == NULL);
+    executionTimer.Start();
+
+    // Skip any image that was acquired before the sensor region changed
+    bool isImageReady = (sourceImage.image.size() == sensorRegion.size());
+
+    // The last processing step writes straight into a pooled frame that is then shared
+    // with every other stage, so no stage needs its own copy of the image.
+    // The image is also skipped when the pool has no frame left to hand out.
+    // When no step changes the pixels and the source lets its buffer be kept, like a GREY image
+    // from a V4L2 camera in grayscale mode, the buffer itself becomes the frame's image.
+    RawPixelFormat rawPixelFormat = sourceImage.rawPixelFormat;
+    bool isConvertImage = (rawPixelFormat != RawPixelFormat::Unknown &&
+        !(isGrayscaleFrame && rawPixelFormat == RawPixelFormat::Mono8));
+    bool isShareSourceImage = (sourceImage.bufferOwner != nullptr && !isConvertImage && !isRemapImage);
+    std::shared_ptr<FrameData> frame;
+    if (isImageReady && isShareSourceImage) {
+        frame = std::make_shared<FrameData>();
+    }
+    else if (isImageReady) {
+        int frameType = sourceImage.image.type();
+        if (rawPixelFormat != RawPixelFormat::Unknown) {
+            frameType = isGrayscaleFrame ? CV_8UC1 : CV_8UC3;
+        }
+        cv::Size frameSize = isRemapImage ? regionMapOutputRegion.size() : sourceImage.image.size();
+        frame = framePool.Acquire(frameSize, frameType);
+        isImageReady = (frame != nullptr);
+    }
+    if (!isImageReady) {
+        numSkippedImages++;
+    }
+
+    try {
         if (isImageReady) {
-            // Convert image to OpenCV mat
-            Spinnaker::ImagePtr convertedImage = pImage->Convert(Spinnaker::PixelFormat_BGR8, Spinnaker::HQ_LINEAR);
-            cv::Mat rawImage = cv::Mat(
-                convertedImage->GetHeight() + convertedImage->GetYPadding(),
-                convertedImage->GetWidth() + convertedImage->GetXPadding(),
-                CV_8UC3, convertedImage->GetData(),
-                convertedImage->GetStride());
-            
+            // Convert raw images
+            // In grayscale mode the image is built straight from the raw Bayer, YUYV or Mono8 buffer
+            // because detection only needs a single channel and a full color debayer is expensive.
+            // Mono8 is used as it is, and when conversion is the only step it writes straight into the frame.
+            bool isFinalStep = !isRemapImage;
+            bool isRawImageInFrame = false;
+            cv::Mat rawImage = sourceImage.image;
+            if (isConvertImage) {
+                cv::Mat convertedImage;
+                cv::Mat& destinationImage = isFinalStep ? frame->image : convertedImage;
+                if (isGrayscaleFrame) {
+                    ConvertRawToGray(sourceImage.image, rawPixelFormat, destinationImage);
+                }
+                else {
+                    ConvertRawToBGR(sourceImage.image, rawPixelFormat, destinationImage);
+                }
+                rawImage = destinationImage;
+                isRawImageInFrame = isFinalStep;
+            }
+
+            // Keep a copy of the image as it came off the sensor for the flight recorder
+            std::chrono::system_clock::time_point captureTime = GetCaptureTime(sourceImage.timestamp, receiveTime);
+            flightRecorder.Record(rawImage, sensorRegion, sensorSize, currentFrameNumber + 1, captureTime);
+
             // Apply the camera calibration
-            // This is done before rotating the image because calibration is calculated at 0 degrees.
-            cv::Mat calibratedImage;
-            if (isApplyCalibrationPreview && calibrationPreviewData.type == CalibrationType::Preview) {
-                cv::remap(rawImage, calibratedImage, calibrationPreviewData.distortMap, calibrationPreviewData.undistortMap, cv::INTER_LINEAR);
+            // The region maps are shifted to sample from the sensor region and only cover the output region,
+            // so a single remap writes the finished image into the frame.
+            // The image stays in the orientation of the sensor. Marker detection turns the marker
+            // coordinates to the orientation of the table instead of turning every pixel.
+            cv::Rect imageRegion = sensorRegion;
+            if (isRemapImage) {
+                cv::remap(rawImage, frame->image, regionDistortMap, regionUndistortMap, cv::INTER_LINEAR);
+                imageRegion = regionMapOutputRegion;
             }
-            else if (isApplyCalibration && calibrationData.type == CalibrationType::Saved) {
-                cv::remap(rawImage, calibratedImage, calibrationData.distortMap, calibrationData.undistortMap, cv::INTER_LINEAR);
+            else if (isShareSourceImage) {
+                frame->image = rawImage;
+                frame->sourceBuffer = sourceImage.bufferOwner;
             }
-            else {
-                calibratedImage = rawImage;
+            else if (!isRawImageInFrame) {
+                rawImage.copyTo(frame->image);
             }
-
-            // Rotate the image 180 degrees if needed
-            cv::Mat rotatedImage;
-            if (isApplyRotation && isRotate) {
-                cv::rotate(calibratedImage, outputImage, cv::ROTATE_180);
-            }
-            else {
-                calibratedImage.copyTo(outputImage);
+            if (isUndistortPoints) {
+                frame->undistortPointMap = activeCalibration->undistortPointMap;
             }
 
             currentFrameNumber++;
+            frame->frameNumber = currentFrameNumber;
+            frame->region = imageRegion;
+            frame->fullSize = sensorSize;
+            frame->captureTime = captureTime;
+            outputFrameMailbox.Publish(frame);
             frameRateTimer.Update();
+            lastFrameTime = std::chrono::steady_clock::now();
+            health = CameraHealth::Streaming;
         }
+    }
+    catch (cv::Exception& exception) {
+        std::cout << "GetFrame() Image Error: " << exception.what() << std::endl;
+    }
 
-        // Release image pointer
-        if (pImage->IsInUse()) {
-            pImage->Release();
-        }
+    // Let the source reuse the image
+    frameSource->Release();
 
-        executionTimer.Stop();
-        //std::cout << "Camera processing: " << executionTimer.duration << " ms" << std::endl;
+    executionTimer.Stop();
+    //std::cout << "Camera processing: " << executionTimer.duration << " ms" << std::endl;
+}
+
+cv::Rect Camera::GetRequestedOutputRegion()
+{
+    cv::Rect fullRegion(cv::Point(0, 0), sensorSize);
+    if (!isUseSensorRegion || !isApplySensorRegion) {
+        return fullRegion;
     }
-    catch (Spinnaker::Exception& exception) {
-        std::cout << "GetFrame() Image Error: " << exception.what() << std::endl;
+
+    cv::Rect2d area;
+    {
+        std::lock_guard<std::mutex> lockGuard(sensorRegionMutex);
+        area = sensorRegionArea;
+    }
+
+    cv::Rect region(
+        cv::Point(std::floor(area.x * sensorSize.width), std::floor(area.y * sensorSize.height)),
+        cv::Point(std::ceil((area.x + area.width) * sensorSize.width), std::ceil((area.y + area.height) * sensorSize.height)));
+    region &= fullRegion;
+    if (region.empty()) {
+        return fullRegion;
+    }
+
+    return region;
+}
+
+void Camera::UpdateRegionMaps(const CalibrationData* calibration, cv::Rect outputRegion)
+{
+    if (outputRegion == regionMapOutputRegion &&
+        calibration == regionMapCalibration &&
+        calibrationVersion == regionMapCalibrationVersion &&
+        !regionMapSensorRegion.empty())
+    {
+        return;
+    }
+
+    regionMapOutputRegion = outputRegion;
+    regionMapCalibration = calibration;
+    regionMapCalibrationVersion = calibrationVersion;
+
+    // Always build new maps because the old ones may share data with the calibration
+    regionDistortMap.release();
+    regionUndistortMap.release();
+
+    // Without calibration the output region is read straight from the sensor
+    if (calibration == NULL) {
+        regionMapSensorRegion = AlignSensorRegion(outputRegion, sensorSize,
+            sensorOffsetIncrement, sensorSizeIncrement, sensorMinimumSize);
+        return;
+    }
+
+    // The full output image uses the full sensor and the calibration maps as they are
+    if (outputRegion.size() == sensorSize) {
+        regionMapSensorRegion = cv::Rect(cv::Point(0, 0), sensorSize);
+        regionDistortMap = calibration->distortMap;
+        regionUndistortMap = calibration->undistortMap;
+        return;
     }
+
+    // With calibration each output pixel is sampled from the position in the distort map,
+    // so the sensor has to read out the bounding box of those positions for the output region.
+    // Bilinear interpolation also reads one pixel past each position.
+    cv::Mat outputDistortMap = calibration->distortMap(outputRegion);
+    std::vector<cv::Mat> mapChannels;
+    cv::split(outputDistortMap, mapChannels);
+    double minX, maxX, minY, maxY;
+    cv::minMaxLoc(mapChannels[0], &minX, &maxX);
+    cv::minMaxLoc(mapChannels[1], &minY, &maxY);
+    cv::Rect sourceRegion(cv::Point(minX, minY), cv::Point(maxX + 2, maxY + 2));
+
+    regionMapSensorRegion = AlignSensorRegion(sourceRegion, sensorSize,
+        sensorOffsetIncrement, sensorSizeIncrement, sensorMinimumSize);
+
+    // Shift the maps so they sample from the sensor region instead of the full image
+    cv::subtract(outputDistortMap, cv::Scalar(regionMapSensorRegion.x, regionMapSensorRegion.y), regionDistortMap);
+    calibration->undistortMap(outputRegion).copyTo(regionUndistortMap);
+}
+
+bool Camera::ConfigureSensorRegion(cv::Rect region)
+{
+    std::lock_guard<std::mutex> lockGuard(cameraParametersMutex);
+    if (frameSource->ConfigureSensorRegion(region)) {
+        sensorRegion = region;
+        std::cout << "Sensor Region: " << region.x << ", " << region.y << ", "
+            << region.width << " x " << region.height << std::endl;
+        return true;
+    }
+
+    // Fall back to the full sensor so this doesn't fail again on every frame and images keep
+    // matching the region. The region maps are rebuilt for it.
+    std::cout << "ConfigureSensorRegion() Error: Region rejected, reading out the full sensor" << std::endl;
+    isUseSensorRegion = false;
+    cv::Rect fullRegion(cv::Point(0, 0), sensorSize);
+    if (!frameSource->ConfigureSensorRegion(fullRegion)) {
+        std::cout << "ConfigureSensorRegion() Error: Unable to read out the full sensor" << std::endl;
+    }
+    sensorRegion = fullRegion;
+    regionMapSensorRegion = cv::Rect();
+    return false;
 }
 
-bool Camera::PrintDeviceInfo(Spinnaker::GenApi::INodeMap& nodeMap)
+bool Camera::ConfigureReadoutMode()
 {
-    bool result = true;
+    std::lock_guard<std::mutex> lockGuard(cameraParametersMutex);
+    ReadoutMode requestedReadoutMode = readoutMode;
+    SensorGeometry sensorGeometry;
+    if (!frameSource->ConfigureReadoutMode(requestedReadoutMode, sensorGeometry)) {
+        // Fall back to the full resolution so this doesn't fail again on every frame
+        readoutMode = ReadoutMode::Full;
+        return false;
+    }
 
-    std::cout << std::endl << "*** DEVICE INFORMATION ***" << std::endl << std::endl;
+    sensorSize = sensorGeometry.size;
+    sensorOffsetIncrement = sensorGeometry.offsetIncrement;
+    sensorSizeIncrement = sensorGeometry.sizeIncrement;
+    sensorMinimumSize = sensorGeometry.minimumSize;
+    sensorRegion = cv::Rect(cv::Point(0, 0), sensorSize);
+    regionMapSensorRegion = cv::Rect();
+    resolution = sensorSize;
+    activeReadoutMode = requestedReadoutMode;
+    std::cout << "Sensor Size: " << sensorSize.width << " x " << sensorSize.height << std::endl;
+
+    emit ResolutionChanged();
+    return true;
+}
 
-    try
+const CalibrationData* Camera::GetScaledCalibration(const CalibrationData* calibration)
+{
+    // The maps are rebuilt once for the current sensor size, which differs from
+    // the calibrated size when the camera is binning or decimating pixels.
+    if (calibration != scaledCalibrationSource ||
+        calibrationVersion != scaledCalibrationVersion ||
+        scaledCalibrationData.distortMap.size() != sensorSize)
     {
-        Spinnaker::GenApi::FeatureList_t features;
-        Spinnaker::GenApi::CCategoryPtr category = nodeMap.GetNode("DeviceInformation");
-        if (IsAvailable(category) && IsReadable(category))
-        {
-            category->GetFeatures(features);
-
-            Spinnaker::GenApi::FeatureList_t::const_iterator it;
-            for (it = features.begin(); it != features.end(); ++it)
-            {
-                Spinnaker::GenApi::CNodePtr pfeatureNode = *it;
-                std::cout << pfeatureNode->GetName() << " : ";
-                Spinnaker::GenApi::CValuePtr pValue = (Spinnaker::GenApi::CValuePtr)pfeatureNode;
-                std::cout << (IsReadable(pValue) ? pValue->ToString().c_str() : "Node not readable");
-                std::cout << std::endl;
-            }
-        }
-        else
-        {
-            std::cout << "Device control information not available." << std::endl;
+        scaledCalibrationData = *calibration;
+        if (scaledCalibrationData.imageSize.empty()) {
+            scaledCalibrationData.imageSize = calibration->distortMap.size();
         }
+        Calibration::InitializeMaps(scaledCalibrationData, sensorSize);
+        scaledCalibrationSource = calibration;
+        scaledCalibrationVersion = calibrationVersion;
     }
-    catch (Spinnaker::Exception& exception)
-    {
-        std::cout << "PrintDeviceInfo() Error: " << exception.what() << std::endl;
-        result = false;
+
+    return &scaledCalibrationData;
+}
+
+std::chrono::system_clock::time_point Camera::GetCaptureTime(long long deviceTimestamp,
+    std::chrono::system_clock::time_point receiveTime)
+{
+    // Without a device timestamp the best estimate is when the image arrived
+    if (deviceTimestamp <= 0) {
+        return receiveTime;
+    }
+
+    // Device timestamps are moved onto the host clock by an offset between the two clocks.
+    // The smallest offset seen belongs to the image that took the least time to arrive,
+    // so it is the closest to the real offset. It creeps up by a microsecond every frame
+    // so it keeps up if the device clock runs slower than the host clock.
+    long long receiveTimestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        receiveTime.time_since_epoch()).count();
+    long long offset = receiveTimestamp - deviceTimestamp;
+    if (isTimestampOffsetValid) {
+        timestampOffset = std::min(offset, timestampOffset + 1000);
+    }
+    else {
+        timestampOffset = offset;
+        isTimestampOffsetValid = true;
     }
 
-    return result;
+    return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::nanoseconds(deviceTimestamp + timestampOffset)));
 }
@@ -30,7 +30,20 @@
 #include "CalibrationData.h"
 #include "FrameRateTimer.h"
 #include "ExecutionTimer.h"
+#include "ImageConversion.h"
+#include "FrameSource.h"
+#include "FrameData.h"
+#include "FramePool.h"
+#include "FrameMailbox.h"
+#include "FrameStatistics.h"
+#include "FlightRecorder.h"
+#include "ExposureController.h"
 #include <QObject>
+#include <condition_variable>
+
+// Whether frames are arriving. A stalled camera is one whose source still looked open
+// but sent no new frame in time, and it is being restarted.
+enum class CameraHealth {Streaming, Stalled, Disconnected};
 
 class Camera : public QObject
 {
@@ -41,51 +54,133 @@ public:
 	~Camera();
     void Run();
     bool GetIsConnected(); // TODO: Replace with a signal on connect or disconnect
-    void CopyImageTo(cv::Mat& destinationImage);
+    std::shared_ptr<const FrameData> GetOutputFrame();
+    std::shared_ptr<const FrameData> WaitForOutputFrame(unsigned int& sequenceNumber, int timeoutMs);
     cv::Size GetResolution();
     unsigned int GetFrameNumber();
     double GetFrameRate();
+    StageStatistics GetStatistics();
+    FlightRecorder& GetFlightRecorder();
+    ExposureController& GetExposureController();
+    long long GetNumIncompleteImages();
+    long long GetNumSkippedImages();
+    long long GetNumStalls();
+    CameraHealth GetHealth();
+    void ResetStatistics();
+
+    static cv::Rect AlignSensorRegion(cv::Rect region, cv::Size sensorSize,
+        cv::Size offsetIncrement, cv::Size sizeIncrement, cv::Size minimumSize);
 
 signals:
     void CameraConnected();
     void CameraDisconnected();
+    void ResolutionChanged();
 
 public slots:
     void Calibrate(CalibrationData calibrationData);
     void ToggleCalibrationPreview(bool isOn);
     void ToggleCalibration(bool isOn);
     void UpdateGamma(double gamma);
-    void UpdateRotation(bool isRotate);
-    void ToggleRotation(bool isOn);
+    void ToggleGrayscale(bool isOn);
+    void TogglePointUndistortion(bool isOn);
+    void UpdateSensorRegion(cv::Rect2d trackingArea);
+    void UpdateUseSensorRegion(bool isUseSensorRegion);
+    void ToggleSensorRegion(bool isOn);
+    void UpdateReadoutMode(ReadoutMode readoutMode);
+    void UpdateFrameSource(FrameSourceData frameSourceData);
+    void UpdateStallTimeout(double seconds);
 
 private:
     void Connect();
 	void Disconnect();
+    void Reconnect();
+    void NotifyDeviceArrival();
     void GetFrame();
-	bool PrintDeviceInfo(Spinnaker::GenApi::INodeMap& nodeMap);
-
-	Spinnaker::SystemPtr spinnakerSystem;
-	Spinnaker::CameraList cameraList;
-	Spinnaker::CameraPtr pCamera;
-	Spinnaker::ImagePtr pImage;
-
-    bool isConnected;
-    cv::Mat outputImage;
+    cv::Rect GetRequestedOutputRegion();
+    void UpdateRegionMaps(const CalibrationData* calibration, cv::Rect outputRegion);
+    bool ConfigureSensorRegion(cv::Rect region);
+    bool ConfigureReadoutMode();
+    const CalibrationData* GetScaledCalibration(const CalibrationData* calibration);
+    std::chrono::system_clock::time_point GetCaptureTime(long long deviceTimestamp,
+        std::chrono::system_clock::time_point receiveTime);
+
+    std::unique_ptr<FrameSource> frameSource;
+    FrameSourceData frameSourceData;
+    bool isFrameSourceChanged;
+
+    std::atomic<bool> isConnected;
+
+    // Reconnection waits longer after each failed attempt unless the device is plugged in
+    std::chrono::milliseconds reconnectDelay;
+    std::chrono::steady_clock::time_point disconnectTime;
+    bool isDeviceArrived;
+    std::mutex reconnectMutex;
+    std::condition_variable reconnectCondition;
+    FramePool framePool;
+    FrameMailbox outputFrameMailbox;
+    cv::Size resolution;
     unsigned int currentFrameNumber;
 
-    double gamma;
-
-    bool isApplyRotation;
-    bool isRotate;
+    long long timestampOffset;
+    bool isTimestampOffsetValid;
 
-    bool isApplyCalibration;
+    // The frame source is only opened, closed or replaced with cameraParametersMutex held, so the
+    // window can set parameters on the open source while the acquisition thread reconnects
+    double gamma;
+    bool isFrameSourceOpen;
+
+    // Settings written by the window and read on the acquisition thread
+    std::atomic<bool> isGrayscale;
+    std::atomic<bool> isPointUndistortion;
+
+    std::atomic<bool> isUseSensorRegion;
+    std::atomic<bool> isApplySensorRegion;
+    cv::Rect2d sensorRegionArea;
+    cv::Size sensorSize;
+    cv::Size sensorOffsetIncrement;
+    cv::Size sensorSizeIncrement;
+    cv::Size sensorMinimumSize;
+    cv::Rect sensorRegion;
+
+    cv::Rect regionMapOutputRegion;
+    cv::Rect regionMapSensorRegion;
+    const CalibrationData* regionMapCalibration;
+    unsigned int regionMapCalibrationVersion;
+    cv::Mat regionDistortMap;
+    cv::Mat regionUndistortMap;
+
+    std::atomic<bool> isApplyCalibration;
     CalibrationData calibrationData;
 
-    bool isApplyCalibrationPreview;
+    std::atomic<bool> isApplyCalibrationPreview;
     CalibrationData calibrationPreviewData;
 
+    unsigned int calibrationVersion;
+
+    CalibrationData scaledCalibrationData;
+    const CalibrationData* scaledCalibrationSource;
+    unsigned int scaledCalibrationVersion;
+
+    std::atomic<ReadoutMode> readoutMode;
+    ReadoutMode activeReadoutMode;
+
 
     std::mutex cameraParametersMutex;
+    std::mutex frameSourceMutex;
+    std::mutex sensorRegionMutex;
+
+    SequenceCounter frameCounter;
+    std::atomic<long long> numIncompleteImages;
+    std::atomic<long long> numSkippedImages;
+
+    // The watchdog restarts acquisition when no new frame comes out for this long
+    std::atomic<double> stallTimeoutSeconds;
+    std::chrono::steady_clock::time_point lastFrameTime;
+    std::atomic<CameraHealth> health;
+    std::atomic<long long> numStalls;
+
+    FlightRecorder flightRecorder;
+    ExposureController exposureController;
 
     FrameRateTimer frameRateTimer;
     ExecutionTimer executionTimer;
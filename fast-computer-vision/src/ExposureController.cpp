@@ -0,0 +1,300 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "ExposureController.h"
+
+// Frames still in the camera's buffers when the exposure changes were captured with the old one
+static const unsigned int kSettleFrames = 3;
+
+// A source that rejected an exposure isn't asked again on every frame
+static const unsigned int kRetryFrames = 30;
+
+// Exposure time is in microseconds
+static const double kMinExposureTime = 20;
+static const double kStartExposureTime = 5000;
+
+// Markers with white cells at this level are clipped, so their contrast can't be measured
+static const int kSaturationLevel = 250;
+static const double kSaturationFactor = 0.7;
+
+// Without markers the middle of the tracking area's histogram is kept at this level
+static const int kTargetBrightness = 110;
+
+// Measuring a few markers is enough and keeps the cost per frame small
+static const int kMaxMeasuredMarkers = 8;
+static const int kBrightnessSampleStep = 4;
+
+// Changes smaller than this are ignored so the exposure doesn't chase noise
+static const double kDeadband = 0.1;
+
+ExposureController::ExposureController() :
+    isAutoExposure(false),
+    maxExposureTime(10000),
+    maxGain(12),
+    targetContrast(80),
+    isExposureChanged(false),
+    isExposureApplied(false),
+    appliedFrameNumber(0),
+    retryFrameNumber(0),
+    isRejectionLogged(false)
+{
+}
+
+void ExposureController::ToggleAutoExposure(bool isOn)
+{
+    std::lock_guard<std::mutex> lockGuard(exposureMutex);
+    if (isOn && !isAutoExposure) {
+        targetExposure.exposureTime = std::min(kStartExposureTime, maxExposureTime);
+        targetExposure.gain = 0;
+        isExposureChanged = true;
+        isExposureApplied = false;
+        retryFrameNumber = 0;
+    }
+    isAutoExposure = isOn;
+}
+
+void ExposureController::UpdateLimits(double maxExposureTime, double maxGain)
+{
+    std::lock_guard<std::mutex> lockGuard(exposureMutex);
+    this->maxExposureTime = std::max(maxExposureTime, kMinExposureTime);
+    this->maxGain = std::max(maxGain, 0.0);
+
+    targetExposure.exposureTime = std::clamp(targetExposure.exposureTime, kMinExposureTime, this->maxExposureTime);
+    targetExposure.gain = std::clamp(targetExposure.gain, 0.0, this->maxGain);
+    isExposureChanged = isAutoExposure;
+}
+
+void ExposureController::UpdateTargetContrast(double targetContrast)
+{
+    std::lock_guard<std::mutex> lockGuard(exposureMutex);
+    this->targetContrast = std::clamp(targetContrast, 1.0, 255.0);
+}
+
+void ExposureController::Measure(const cv::Mat& image, const std::vector<std::vector<cv::Point2f>>& markerCorners,
+    unsigned int frameNumber)
+{
+    // Only frames captured well after the last change show its effect
+    double targetContrast;
+    {
+        std::lock_guard<std::mutex> lockGuard(exposureMutex);
+        if (!isAutoExposure || !isExposureApplied || isExposureChanged ||
+            frameNumber <= appliedFrameNumber + kSettleFrames)
+        {
+            return;
+        }
+        targetContrast = this->targetContrast;
+    }
+
+    if (image.empty()) {
+        return;
+    }
+
+    // Contrast and brightness both scale with exposure time and gain, so the change needed
+    // is the ratio between the target and the measurement.
+    // Clipped markers don't show their real contrast, so the exposure backs off first.
+    double factor;
+    double contrast;
+    double whiteLevel;
+    if (MeasureMarkerContrast(image, markerCorners, contrast, whiteLevel)) {
+        if (whiteLevel >= kSaturationLevel) {
+            factor = kSaturationFactor;
+        }
+        else {
+            factor = targetContrast / std::max(contrast, 1.0);
+        }
+    }
+    else {
+        factor = (double)kTargetBrightness / std::max(MeasureBrightness(image), 1);
+    }
+
+    // Half of the change, on a log scale, is made at a time so the loop settles without overshooting
+    factor = std::sqrt(std::clamp(factor, 0.25, 4.0));
+    if (std::abs(factor - 1) < kDeadband) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lockGuard(exposureMutex);
+    AdjustBrightness(factor);
+}
+
+bool ExposureController::GetNewExposure(CameraExposure& exposure, unsigned int frameNumber)
+{
+    std::lock_guard<std::mutex> lockGuard(exposureMutex);
+    if (!isAutoExposure || !isExposureChanged || frameNumber < retryFrameNumber) {
+        return false;
+    }
+
+    exposure = targetExposure;
+    isExposureChanged = false;
+    return true;
+}
+
+void ExposureController::SetAppliedExposure(CameraExposure exposure, unsigned int frameNumber)
+{
+    std::lock_guard<std::mutex> lockGuard(exposureMutex);
+    appliedExposure = exposure;
+    appliedFrameNumber = frameNumber;
+    isExposureApplied = true;
+}
+
+void ExposureController::SetExposureRejected(unsigned int frameNumber)
+{
+    // The change stays pending, otherwise measuring would wait for it forever.
+    // The target is kept unless a newer one was set in the meantime.
+    std::lock_guard<std::mutex> lockGuard(exposureMutex);
+    isExposureChanged = isAutoExposure;
+    retryFrameNumber = frameNumber + kRetryFrames;
+
+    if (!isRejectionLogged) {
+        std::cout << "Auto Exposure: The frame source doesn't accept exposure changes, retrying every "
+            << kRetryFrames << " frames" << std::endl;
+        isRejectionLogged = true;
+    }
+}
+
+void ExposureController::Reset()
+{
+    // A camera that was reconnected needs the exposure applied again
+    std::lock_guard<std::mutex> lockGuard(exposureMutex);
+    isExposureApplied = false;
+    isExposureChanged = isAutoExposure;
+    retryFrameNumber = 0;
+    isRejectionLogged = false;
+}
+
+bool ExposureController::MeasureMarkerContrast(const cv::Mat& image,
+    const std::vector<std::vector<cv::Point2f>>& markerCorners, double& contrast, double& whiteLevel)
+{
+    // The black and white levels of a marker are a low and a high percentile of the pixels
+    // inside it, which covers its black border as well as its black and white bits.
+    // The lowest contrast of any marker is the decode margin that has to be kept.
+    cv::Rect imageArea(0, 0, image.cols, image.rows);
+    int numMarkers = std::min((int)markerCorners.size(), kMaxMeasuredMarkers);
+    bool isMeasured = false;
+    contrast = 255;
+    whiteLevel = 0;
+
+    for (int i = 0; i < numMarkers; i++) {
+        std::vector<cv::Point> polygon;
+        for (int j = 0; j < markerCorners[i].size(); j++) {
+            polygon.push_back(cv::Point(cvRound(markerCorners[i][j].x), cvRound(markerCorners[i][j].y)));
+        }
+        cv::Rect markerArea = cv::boundingRect(polygon) & imageArea;
+        if (markerArea.empty()) {
+            continue;
+        }
+
+        if (image.channels() == 1) {
+            markerImage = image(markerArea);
+        }
+        else {
+            cv::cvtColor(image(markerArea), markerImage, cv::COLOR_BGR2GRAY);
+        }
+
+        for (int j = 0; j < polygon.size(); j++) {
+            polygon[j] -= markerArea.tl();
+        }
+        markerMask.create(markerArea.size(), CV_8UC1);
+        markerMask.setTo(cv::Scalar(0));
+        cv::fillConvexPoly(markerMask, polygon, cv::Scalar(255));
+
+        std::array<int, 256> histogram = {};
+        int numPixels = 0;
+        for (int y = 0; y < markerImage.rows; y++) {
+            const uchar* imageRow = markerImage.ptr<uchar>(y);
+            const uchar* maskRow = markerMask.ptr<uchar>(y);
+            for (int x = 0; x < markerImage.cols; x++) {
+                if (maskRow[x] != 0) {
+                    histogram[imageRow[x]]++;
+                    numPixels++;
+                }
+            }
+        }
+        if (numPixels == 0) {
+            continue;
+        }
+
+        int markerBlackLevel = GetPercentile(histogram, numPixels, 0.05);
+        int markerWhiteLevel = GetPercentile(histogram, numPixels, 0.95);
+        contrast = std::min(contrast, (double)(markerWhiteLevel - markerBlackLevel));
+        whiteLevel = std::max(whiteLevel, (double)markerWhiteLevel);
+        isMeasured = true;
+    }
+
+    return isMeasured;
+}
+
+int ExposureController::MeasureBrightness(const cv::Mat& image)
+{
+    // The median of a sparse grid of pixels, from the green channel of color images
+    int numChannels = image.channels();
+    int channel = (numChannels == 1) ? 0 : 1;
+    std::array<int, 256> histogram = {};
+    int numPixels = 0;
+    for (int y = 0; y < image.rows; y += kBrightnessSampleStep) {
+        const uchar* imageRow = image.ptr<uchar>(y);
+        for (int x = 0; x < image.cols; x += kBrightnessSampleStep) {
+            histogram[imageRow[x * numChannels + channel]]++;
+            numPixels++;
+        }
+    }
+
+    return GetPercentile(histogram, numPixels, 0.5);
+}
+
+void ExposureController::AdjustBrightness(double factor)
+{
+    // Brightness is the exposure time times the linear gain. It goes into the exposure time first
+    // and only the part that the longest exposure can't reach goes into gain.
+    double brightness = appliedExposure.exposureTime * std::pow(10.0, appliedExposure.gain / 20) * factor;
+    CameraExposure exposure;
+    exposure.exposureTime = std::clamp(brightness, kMinExposureTime, maxExposureTime);
+    exposure.gain = std::clamp(20 * std::log10(brightness / exposure.exposureTime), 0.0, maxGain);
+
+    // At a limit there is nothing left to change
+    if (std::abs(exposure.exposureTime - appliedExposure.exposureTime) < 1 &&
+        std::abs(exposure.gain - appliedExposure.gain) < 0.1)
+    {
+        return;
+    }
+
+    targetExposure = exposure;
+    isExposureChanged = true;
+}
+
+int ExposureController::GetPercentile(const std::array<int, 256>& histogram, int numPixels, double percentile)
+{
+    int count = 0;
+    int threshold = (int)(numPixels * percentile);
+    for (int level = 0; level < 256; level++) {
+        count += histogram[level];
+        if (count > threshold) {
+            return level;
+        }
+    }
+    return 255;
+}
@@ -0,0 +1,80 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "FrameSource.h"
+
+// Adjusts the camera's exposure time and gain so markers can be read with the shortest exposure.
+// Detection measures the contrast between the black and white cells of the markers it found,
+// or the brightness of the tracking area when it found none, and the camera applies the new
+// exposure between frames on its acquisition thread. Short exposures blur moving markers less
+// and let the camera run at its highest frame rate, so gain is only added once the exposure
+// time reaches its limit.
+class ExposureController
+{
+public:
+    ExposureController();
+    void ToggleAutoExposure(bool isOn);
+    void UpdateLimits(double maxExposureTime, double maxGain);
+    void UpdateTargetContrast(double targetContrast);
+    void Measure(const cv::Mat& image, const std::vector<std::vector<cv::Point2f>>& markerCorners,
+        unsigned int frameNumber);
+    bool GetNewExposure(CameraExposure& exposure, unsigned int frameNumber);
+    void SetAppliedExposure(CameraExposure exposure, unsigned int frameNumber);
+    void SetExposureRejected(unsigned int frameNumber);
+    void Reset();
+
+private:
+    bool MeasureMarkerContrast(const cv::Mat& image, const std::vector<std::vector<cv::Point2f>>& markerCorners,
+        double& contrast, double& whiteLevel);
+    int MeasureBrightness(const cv::Mat& image);
+    void AdjustBrightness(double factor);
+    static int GetPercentile(const std::array<int, 256>& histogram, int numPixels, double percentile);
+
+    bool isAutoExposure;
+    double maxExposureTime;
+    double maxGain;
+    double targetContrast;
+
+    // The exposure waiting to be applied and the one the camera last applied
+    CameraExposure targetExposure;
+    CameraExposure appliedExposure;
+    bool isExposureChanged;
+    bool isExposureApplied;
+    unsigned int appliedFrameNumber;
+
+    // A rejected exposure is tried again a little later
+    unsigned int retryFrameNumber;
+    bool isRejectionLogged;
+
+    std::mutex exposureMutex;
+
+    // Only used on the detection thread
+    cv::Mat markerImage;
+    cv::Mat markerMask;
+};
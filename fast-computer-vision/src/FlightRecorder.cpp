@@ -0,0 +1,338 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "FlightRecorder.h"
+#include <QDir>
+#include <QDateTime>
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const size_t kBytesPerMegabyte = 1024 * 1024;
+
+// Memory used by a recorded image, compressed or not
+static size_t GetRecordedBytes(const RecordedFrame& frame)
+{
+    if (frame.compression != RecordingCompression::None) {
+        return frame.compressedImage.size();
+    }
+    return frame.image.total() * frame.image.elemSize();
+}
+
+FlightRecorder::FlightRecorder() :
+    isRunning(true),
+    durationSeconds(0),
+    maxBytes(1024 * kBytesPerMegabyte),
+    isAutoDump(true),
+    isPending(false),
+    numSkippedFrames(0),
+    isDumpRequested(false),
+    numBytes(0),
+    warnedDurationSeconds(0),
+    averageMarkerCount(0),
+    isMarkerCountValid(false)
+{
+    recorderThread = std::thread(&FlightRecorder::Run, this);
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    {
+        std::lock_guard<std::mutex> lockGuard(recorderMutex);
+        isRunning = false;
+    }
+    recorderCondition.notify_one();
+    recorderThread.join();
+}
+
+void FlightRecorder::UpdateDuration(double seconds)
+{
+    durationSeconds = seconds;
+}
+
+void FlightRecorder::UpdateMemoryLimit(int megabytes)
+{
+    maxBytes = (size_t)std::max(megabytes, 1) * kBytesPerMegabyte;
+}
+
+void FlightRecorder::ToggleAutoDump(bool isOn)
+{
+    isAutoDump = isOn;
+}
+
+void FlightRecorder::Record(const cv::Mat& image, cv::Rect region, cv::Size fullSize,
+    unsigned int frameNumber, std::chrono::system_clock::time_point captureTime)
+{
+    if (durationSeconds <= 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lockGuard(recorderMutex);
+
+    // Skip the image if the recorder is still busy with the last one
+    if (isPending) {
+        numSkippedFrames++;
+        return;
+    }
+
+    // Only the sensor region is copied here. The padding to the full sensor is added on playback.
+    // The copy reuses the buffer of an image that was already compressed or dropped.
+    image.copyTo(pendingFrame.image);
+    pendingFrame.region = region;
+    pendingFrame.fullSize = fullSize;
+    pendingFrame.frameNumber = frameNumber;
+    pendingFrame.captureTime = captureTime;
+    isPending = true;
+    recorderCondition.notify_one();
+}
+
+void FlightRecorder::UpdateMarkerCount(int numMarkers)
+{
+    if (!isAutoDump || durationSeconds <= 0) {
+        return;
+    }
+
+    // A sudden drop is when at least two markers and at least half of the recent
+    // average disappear at once. Each dump is followed by a quiet period so one
+    // problem doesn't fill the disk.
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (isMarkerCountValid && now >= nextAutoDumpTime &&
+        averageMarkerCount - numMarkers >= 2 && numMarkers <= averageMarkerCount * 0.5)
+    {
+        // Wait so the dump shows what happened after the drop as well as before it
+        std::stringstream reason;
+        reason << "Marker count dropped from " << std::round(averageMarkerCount) << " to " << numMarkers;
+        RequestDump(reason.str(), durationSeconds / 2);
+        nextAutoDumpTime = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(durationSeconds * 2));
+    }
+
+    averageMarkerCount = isMarkerCountValid ? (0.9 * averageMarkerCount + 0.1 * numMarkers) : numMarkers;
+    isMarkerCountValid = true;
+}
+
+void FlightRecorder::RequestDump(std::string reason, double delaySeconds)
+{
+    std::lock_guard<std::mutex> lockGuard(recorderMutex);
+    if (isDumpRequested) {
+        return;
+    }
+
+    dumpReason = reason;
+    dumpTime = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(delaySeconds));
+    isDumpRequested = true;
+    recorderCondition.notify_one();
+}
+
+void FlightRecorder::Run()
+{
+    // Compression and saving shouldn't take time away from acquisition or detection
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+#endif
+
+    std::unique_lock<std::mutex> lock(recorderMutex);
+    while (isRunning) {
+        recorderCondition.wait_for(lock, std::chrono::milliseconds(100));
+
+        if (isPending) {
+            // Take the image and give the camera a spare buffer for the next one
+            RecordedFrame frame = std::move(pendingFrame);
+            pendingFrame = RecordedFrame();
+            pendingFrame.image = spareImage;
+            spareImage.release();
+            isPending = false;
+
+            lock.unlock();
+            StoreFrame(frame);
+            lock.lock();
+        }
+
+        if (isDumpRequested && std::chrono::steady_clock::now() >= dumpTime) {
+            std::string reason = dumpReason;
+            isDumpRequested = false;
+
+            lock.unlock();
+            Dump(reason);
+            lock.lock();
+        }
+
+        if (durationSeconds <= 0 && !frames.empty()) {
+            frames.clear();
+            numBytes = 0;
+        }
+    }
+}
+
+void FlightRecorder::StoreFrame(RecordedFrame& frame)
+{
+    CompressFrame(frame);
+    numBytes += GetRecordedBytes(frame);
+    frames.push_back(std::move(frame));
+
+    // Drop the oldest images once the recording is longer than the duration or over the memory limit.
+    // An uncompressed image that is dropped is kept as the buffer for a later copy.
+    std::chrono::duration<double> duration(durationSeconds);
+    while (frames.size() > 1 &&
+        (frames.back().captureTime - frames.front().captureTime > duration || numBytes > maxBytes))
+    {
+        // Say once for each duration when the memory limit cuts the recording short
+        std::chrono::duration<double> recordedDuration = frames.back().captureTime - frames.front().captureTime;
+        if (recordedDuration <= duration && warnedDurationSeconds != duration.count()) {
+            warnedDurationSeconds = duration.count();
+            size_t neededBytes = (size_t)(numBytes * duration.count() / std::max(recordedDuration.count(), 0.001));
+            std::cout << "Flight Recorder: Only " << cv::format("%.1f of %.1f", recordedDuration.count(), duration.count())
+                << " seconds fit in " << maxBytes / kBytesPerMegabyte << " MB, about " << neededBytes / kBytesPerMegabyte
+                << " MB are needed" << std::endl;
+        }
+
+        numBytes -= GetRecordedBytes(frames.front());
+        if (!frames.front().image.empty()) {
+            spareImage = frames.front().image;
+        }
+        frames.pop_front();
+    }
+}
+
+void FlightRecorder::CompressFrame(RecordedFrame& frame)
+{
+    // Without LZ4 the image is kept as it is
+    frame.imageType = frame.image.type();
+
+#ifdef USE_LZ4
+    // LZ4 keeps up with the camera on this one thread, which PNG couldn't. The image is
+    // continuous because it was copied out of the sensor region.
+    int numImageBytes = (int)(frame.image.total() * frame.image.elemSize());
+    compressionBuffer.resize(LZ4_compressBound(numImageBytes));
+    int numCompressedBytes = LZ4_compress_default((const char*)frame.image.data, compressionBuffer.data(),
+        numImageBytes, (int)compressionBuffer.size());
+    if (numCompressedBytes <= 0) {
+        std::cout << "CompressFrame() Error: Unable to compress image " << frame.frameNumber << std::endl;
+        return;
+    }
+
+    frame.compressedImage.assign(compressionBuffer.begin(), compressionBuffer.begin() + numCompressedBytes);
+    frame.compression = RecordingCompression::LZ4;
+    spareImage = frame.image;
+    frame.image.release();
+#endif
+}
+
+void FlightRecorder::Dump(std::string reason)
+{
+    if (frames.empty()) {
+        return;
+    }
+
+    // Report the frame rate that was actually recorded, which is lower than the camera's
+    // when images were skipped or the memory limit cut the recording short
+    double recordedSeconds = std::chrono::duration<double>(frames.back().captureTime - frames.front().captureTime).count();
+    double recordedFrameRate = (recordedSeconds > 0) ? (frames.size() - 1) / recordedSeconds : 0;
+    unsigned int numSkipped;
+    {
+        std::lock_guard<std::mutex> lockGuard(recorderMutex);
+        numSkipped = numSkippedFrames;
+        numSkippedFrames = 0;
+    }
+    std::string reasonText = reason + "\n" + cv::format("%d images over %.2f seconds at %.1f fps, %u skipped since the last save",
+        (int)frames.size(), recordedSeconds, recordedFrameRate, numSkipped);
+
+    QDir dumpDirectory("FlightRecorder");
+    if (!dumpDirectory.exists()) {
+        dumpDirectory.mkpath(".");
+    }
+    QString date = QDateTime::currentDateTime().date().toString(Qt::ISODate).remove("-");
+    QString time = QDateTime::currentDateTime().time().toString().remove(":");
+    std::string dumpPath = dumpDirectory.filePath(date + "-" + time + ".fcvr").toStdString();
+
+    std::ofstream file(dumpPath, std::ios::binary);
+    if (!file) {
+        std::cout << "Dump() Error: Unable to write " << dumpPath << std::endl;
+        return;
+    }
+
+    // The header is written again at the end, once the index offset is known
+    RecordingHeader header = {};
+    std::memcpy(header.magic, kRecordingMagic, sizeof(header.magic));
+    header.version = kRecordingVersion;
+    header.numFrames = (uint32_t)frames.size();
+    header.reasonOffset = sizeof(header);
+    header.reasonLength = reasonText.size();
+    file.write((const char*)&header, sizeof(header));
+    file.write(reasonText.data(), reasonText.size());
+
+    std::vector<RecordingIndexEntry> index(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        const RecordedFrame& frame = frames[i];
+        RecordingIndexEntry& entry = index[i];
+        entry.dataOffset = (uint64_t)file.tellp();
+        entry.dataSize = GetRecordedBytes(frame);
+        entry.captureTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            frame.captureTime.time_since_epoch()).count();
+        entry.frameNumber = frame.frameNumber;
+        entry.compression = (uint32_t)frame.compression;
+        entry.regionX = frame.region.x;
+        entry.regionY = frame.region.y;
+        entry.regionWidth = frame.region.width;
+        entry.regionHeight = frame.region.height;
+        entry.fullWidth = frame.fullSize.width;
+        entry.fullHeight = frame.fullSize.height;
+        entry.imageType = frame.imageType;
+
+        if (frame.compression != RecordingCompression::None) {
+            file.write(frame.compressedImage.data(), frame.compressedImage.size());
+        }
+        else {
+            file.write((const char*)frame.image.data, entry.dataSize);
+        }
+    }
+
+    // The index is aligned so it can be read in place from a memory mapped file
+    static const char kPadding[8] = {};
+    file.write(kPadding, (8 - file.tellp() % 8) % 8);
+    header.indexOffset = (uint64_t)file.tellp();
+    file.write((const char*)index.data(), index.size() * sizeof(RecordingIndexEntry));
+    file.seekp(0);
+    file.write((const char*)&header, sizeof(header));
+    file.close();
+
+    if (file.fail()) {
+        std::cout << "Dump() Error: Unable to write " << dumpPath << std::endl;
+        return;
+    }
+
+    std::cout << "Flight Recorder: Saved " << frames.size() << " images at " << cv::format("%.1f", recordedFrameRate)
+        << " fps to " << dumpPath << " (" << reason << ")" << std::endl;
+}
@@ -0,0 +1,101 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "FlightRecording.h"
+#include <condition_variable>
+#include <deque>
+
+struct RecordedFrame
+{
+    // The sensor region as it came from the camera. It is released once the image is compressed.
+    cv::Mat image;
+    std::vector<char> compressedImage;
+    RecordingCompression compression = RecordingCompression::None;
+    int imageType = 0;
+    cv::Rect region;
+    cv::Size fullSize;
+    unsigned int frameNumber = 0;
+    std::chrono::system_clock::time_point captureTime;
+};
+
+// Keeps the last few seconds of camera images, before calibration,
+// in memory so they can be saved when tracking goes wrong.
+// Only the sensor region is copied. The camera hands images to a low priority thread,
+// which compresses them with LZ4 when it is available, and never waits for it.
+// Images that arrive while it is busy are skipped.
+// Saves are a single indexed file that the recording frame source plays back.
+class FlightRecorder
+{
+public:
+    FlightRecorder();
+    ~FlightRecorder();
+    void UpdateDuration(double seconds);
+    void UpdateMemoryLimit(int megabytes);
+    void ToggleAutoDump(bool isOn);
+    void Record(const cv::Mat& image, cv::Rect region, cv::Size fullSize,
+        unsigned int frameNumber, std::chrono::system_clock::time_point captureTime);
+    void UpdateMarkerCount(int numMarkers);
+    void RequestDump(std::string reason, double delaySeconds = 0);
+
+private:
+    void Run();
+    void StoreFrame(RecordedFrame& frame);
+    void CompressFrame(RecordedFrame& frame);
+    void Dump(std::string reason);
+
+    std::thread recorderThread;
+    bool isRunning;
+    std::atomic<double> durationSeconds;
+    std::atomic<size_t> maxBytes;
+    std::atomic<bool> isAutoDump;
+
+    // Handed over from the camera thread
+    RecordedFrame pendingFrame;
+    bool isPending;
+    unsigned int numSkippedFrames;
+
+    std::string dumpReason;
+    std::chrono::steady_clock::time_point dumpTime;
+    bool isDumpRequested;
+
+    std::mutex recorderMutex;
+    std::condition_variable recorderCondition;
+
+    // Only used on the recorder thread
+    std::deque<RecordedFrame> frames;
+    size_t numBytes;
+    cv::Mat spareImage;
+    std::vector<char> compressionBuffer;
+    double warnedDurationSeconds;
+
+    // Only used on the detection thread
+    double averageMarkerCount;
+    bool isMarkerCountValid;
+    std::chrono::steady_clock::time_point nextAutoDumpTime;
+};
@@ -0,0 +1,70 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+
+// The file the flight recorder saves. It starts with a header and the reason it was saved,
+// followed by the images one after another and an index with one entry per image.
+// Every field has a fixed size and place so the file can be memory mapped and
+// any image found through the index without reading the ones before it.
+static const char kRecordingMagic[8] = {'F', 'C', 'V', 'R', 'E', 'C', 'O', 'R'};
+static const uint32_t kRecordingVersion = 1;
+
+enum class RecordingCompression : uint32_t {None, LZ4};
+
+struct RecordingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numFrames;
+    uint64_t indexOffset;
+    uint64_t reasonOffset;
+    uint64_t reasonLength;
+};
+
+// Only the sensor region is stored, in the OpenCV type it came from the camera in.
+// Uncompressed images are stored row after row without padding.
+struct RecordingIndexEntry
+{
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    int64_t captureTimeUs;
+    uint32_t frameNumber;
+    uint32_t compression;
+    int32_t regionX;
+    int32_t regionY;
+    int32_t regionWidth;
+    int32_t regionHeight;
+    int32_t fullWidth;
+    int32_t fullHeight;
+    int32_t imageType;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(RecordingHeader) == 40, "The recording header must not change size");
+static_assert(sizeof(RecordingIndexEntry) == 64, "The recording index entry must not change size");
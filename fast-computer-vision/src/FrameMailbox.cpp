@@ -0,0 +1,82 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "FrameMailbox.h"
+
+FrameMailbox::FrameMailbox() :
+    currentSequenceNumber(0)
+{
+}
+
+FrameMailbox::~FrameMailbox()
+{
+}
+
+void FrameMailbox::Publish(std::shared_ptr<const FrameData> frame)
+{
+    {
+        std::lock_guard<std::mutex> lockGuard(frameMutex);
+        this->frame = frame;
+        currentSequenceNumber++;
+    }
+    frameCondition.notify_all();
+}
+
+void FrameMailbox::Clear()
+{
+    std::lock_guard<std::mutex> lockGuard(frameMutex);
+    frame = nullptr;
+}
+
+std::shared_ptr<const FrameData> FrameMailbox::Peek()
+{
+    std::lock_guard<std::mutex> lockGuard(frameMutex);
+    return frame;
+}
+
+std::shared_ptr<const FrameData> FrameMailbox::WaitForNewer(unsigned int& sequenceNumber, int timeoutMs)
+{
+    // Returns the newest frame if it was published after sequenceNumber, otherwise nullptr on timeout.
+    // sequenceNumber is updated so the caller can pass it straight back in on the next call.
+    std::unique_lock<std::mutex> lock(frameMutex);
+    bool isNewer = frameCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] {
+        return currentSequenceNumber != sequenceNumber && frame != nullptr;
+    });
+
+    if (!isNewer) {
+        return nullptr;
+    }
+
+    sequenceNumber = currentSequenceNumber;
+    return frame;
+}
+
+unsigned int FrameMailbox::GetSequenceNumber()
+{
+    std::lock_guard<std::mutex> lockGuard(frameMutex);
+    return currentSequenceNumber;
+}
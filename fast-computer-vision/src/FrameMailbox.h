@@ -0,0 +1,53 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "FrameData.h"
+#include <condition_variable>
+
+// A single slot mailbox where the newest frame always wins.
+// The producer never waits on consumers, and a consumer that falls behind
+// skips straight to the freshest frame instead of working through a backlog.
+class FrameMailbox
+{
+public:
+    FrameMailbox();
+    ~FrameMailbox();
+    void Publish(std::shared_ptr<const FrameData> frame);
+    void Clear();
+    std::shared_ptr<const FrameData> Peek();
+    std::shared_ptr<const FrameData> WaitForNewer(unsigned int& sequenceNumber, int timeoutMs);
+    unsigned int GetSequenceNumber();
+
+private:
+    std::shared_ptr<const FrameData> frame;
+    unsigned int currentSequenceNumber;
+
+    std::mutex frameMutex;
+    std::condition_variable frameCondition;
+};
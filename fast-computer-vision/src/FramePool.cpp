@@ -0,0 +1,91 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "FramePool.h"
+
+// The pool only grows while stages hold more frames than it has, which is a few more than the
+// number of detection workers, so this limit is only reached when frames are never let go of
+static const int kMaxNumFrames = 32;
+
+FramePool::FramePool(int numFrames, cv::Size imageSize, int imageType) :
+    nextIndex(0)
+{
+    for (int i = 0; i < numFrames; i++) {
+        std::shared_ptr<FrameData> frame = std::make_shared<FrameData>();
+        frame->image.create(imageSize, imageType);
+        frames.push_back(frame);
+    }
+}
+
+FramePool::~FramePool()
+{
+}
+
+std::shared_ptr<FrameData> FramePool::Acquire(cv::Size imageSize, int imageType)
+{
+    std::lock_guard<std::mutex> lockGuard(framesMutex);
+
+    // A frame is free when the pool holds the only reference to it.
+    // Nothing else can gain a new reference to a free frame because
+    // references are only ever copied from a stage that already holds one.
+    std::shared_ptr<FrameData> frame;
+    int numFrames = frames.size();
+    for (int i = 0; i < numFrames; i++) {
+        int index = (nextIndex + i) % numFrames;
+        if (frames[index].use_count() == 1) {
+            frame = frames[index];
+            nextIndex = (index + 1) % numFrames;
+            break;
+        }
+    }
+
+    // Every frame is still in use by a stage, so grow the pool rather than block the camera.
+    // Past the limit a stage is holding on to frames for too long, and no frame is handed out.
+    if (frame == nullptr) {
+        if (numFrames >= kMaxNumFrames) {
+            return nullptr;
+        }
+        frame = std::make_shared<FrameData>();
+        frames.push_back(frame);
+    }
+
+    // This only allocates if the size or type has changed
+    frame->image.create(imageSize, imageType);
+    frame->frameNumber = 0;
+    frame->region = cv::Rect(cv::Point(0, 0), imageSize);
+    frame->fullSize = imageSize;
+    frame->captureTime = std::chrono::system_clock::time_point();
+    frame->undistortPointMap.release();
+
+    return frame;
+}
+
+int FramePool::GetNumFrames()
+{
+    std::lock_guard<std::mutex> lockGuard(framesMutex);
+    return frames.size();
+}
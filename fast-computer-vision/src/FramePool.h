@@ -0,0 +1,48 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "FrameData.h"
+
+// A ring of preallocated frame buffers that are shared between the processing stages.
+// Frames are handed out as reference-counted pointers, and a buffer is only reused once
+// every stage has let go of it, so stages can hold the same pixels without copying them.
+class FramePool
+{
+public:
+    FramePool(int numFrames, cv::Size imageSize, int imageType);
+    ~FramePool();
+    std::shared_ptr<FrameData> Acquire(cv::Size imageSize, int imageType);
+    int GetNumFrames();
+
+private:
+    std::vector<std::shared_ptr<FrameData>> frames;
+    int nextIndex;
+
+    std::mutex framesMutex;
+};
@@ -0,0 +1,175 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "FrameSource.h"
+#include "VideoFrameSource.h"
+#include "ImageSequenceFrameSource.h"
+#include "SyntheticFrameSource.h"
+#include "RecordingFrameSource.h"
+#ifdef USE_SPINNAKER
+#include "SpinnakerFrameSource.h"
+#endif
+#ifdef __linux__
+#include "V4L2FrameSource.h"
+#endif
+
+SoftwareFrameSource::SoftwareFrameSource(FramePacing pacing, double frameRate) :
+    frameRate(frameRate),
+    pacing(pacing),
+    numImagesRead(0),
+    readoutMode(ReadoutMode::Full)
+{
+}
+
+bool SoftwareFrameSource::ConfigureReadoutMode(ReadoutMode readoutMode, SensorGeometry& sensorGeometry)
+{
+    this->readoutMode = readoutMode;
+
+    cv::Size imageSize = GetImageSize();
+    if (readoutMode != ReadoutMode::Full) {
+        imageSize = cv::Size(imageSize.width / 2, imageSize.height / 2);
+    }
+
+    // Regions are aligned to 2 x 2 pixels so Bayer images keep their color pattern
+    sensorGeometry.size = imageSize;
+    sensorGeometry.offsetIncrement = cv::Size(2, 2);
+    sensorGeometry.sizeIncrement = cv::Size(2, 2);
+    sensorGeometry.minimumSize = cv::Size(2, 2);
+    sensorRegion = cv::Rect(cv::Point(0, 0), imageSize);
+
+    return true;
+}
+
+bool SoftwareFrameSource::ConfigureSensorRegion(cv::Rect region)
+{
+    sensorRegion = region;
+    return true;
+}
+
+bool SoftwareFrameSource::ConfigureGamma(double gamma)
+{
+    // Recorded images already have the gamma of the camera that recorded them
+    return true;
+}
+
+bool SoftwareFrameSource::ConfigureExposure(CameraExposure& exposure)
+{
+    // Recorded images keep the exposure they were recorded with
+    return false;
+}
+
+bool SoftwareFrameSource::Grab(SourceImage& sourceImage, bool isGrayscale)
+{
+    WaitForNextFrame();
+    if (!ReadImage(fullImage)) {
+        return false;
+    }
+
+    sourceImage = fullImage;
+    sourceImage.frameId = numImagesRead;
+    numImagesRead++;
+
+    if (readoutMode != ReadoutMode::Full) {
+        // Binning or decimating a Bayer mosaic would mix up its colors, so it is converted first
+        if (sourceImage.rawPixelFormat != RawPixelFormat::Unknown &&
+            sourceImage.rawPixelFormat != RawPixelFormat::Mono8)
+        {
+            ConvertRawToBGR(sourceImage.image, sourceImage.rawPixelFormat, colorImage);
+            sourceImage.image = colorImage;
+            sourceImage.rawPixelFormat = RawPixelFormat::Unknown;
+        }
+
+        // Binning averages each 2 x 2 block and decimation keeps its top left pixel
+        int interpolation = (readoutMode == ReadoutMode::Binning2x2) ? cv::INTER_AREA : cv::INTER_NEAREST;
+        cv::resize(sourceImage.image, readoutImage,
+            cv::Size(sourceImage.image.cols / 2, sourceImage.image.rows / 2), 0, 0, interpolation);
+        sourceImage.image = readoutImage;
+    }
+
+    cv::Rect imageArea(0, 0, sourceImage.image.cols, sourceImage.image.rows);
+    if (sensorRegion != imageArea) {
+        sourceImage.image = sourceImage.image(sensorRegion & imageArea);
+    }
+
+    return true;
+}
+
+void SoftwareFrameSource::Release()
+{
+    // Images are owned by the source and reused for the next frame
+}
+
+void SoftwareFrameSource::ResetPacing()
+{
+    nextFrameTime = std::chrono::steady_clock::now();
+}
+
+void SoftwareFrameSource::WaitForNextFrame()
+{
+    if (pacing != FramePacing::RealTime || frameRate <= 0) {
+        return;
+    }
+
+    std::chrono::steady_clock::duration framePeriod =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / frameRate));
+
+    // If processing fell more than a frame behind, skip ahead instead of
+    // handing out a burst of frames to catch up, just like a live camera would.
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (nextFrameTime > now) {
+        std::this_thread::sleep_until(nextFrameTime);
+    }
+    else if (now - nextFrameTime > framePeriod) {
+        nextFrameTime = now;
+    }
+    nextFrameTime += framePeriod;
+}
+
+std::unique_ptr<FrameSource> CreateFrameSource(const FrameSourceData& frameSourceData)
+{
+    switch (frameSourceData.type) {
+    case FrameSourceType::Video:
+        return std::make_unique<VideoFrameSource>(frameSourceData.path, frameSourceData.pacing, frameSourceData.frameRate);
+    case FrameSourceType::ImageSequence:
+        return std::make_unique<ImageSequenceFrameSource>(frameSourceData.path, frameSourceData.pacing, frameSourceData.frameRate);
+    case FrameSourceType::Synthetic:
+        return std::make_unique<SyntheticFrameSource>(frameSourceData);
+    case FrameSourceType::Recording:
+        return std::make_unique<RecordingFrameSource>(frameSourceData.path, frameSourceData.pacing, frameSourceData.frameRate);
+#ifdef __linux__
+    case FrameSourceType::V4L2:
+        return std::make_unique<V4L2FrameSource>(frameSourceData.path);
+#endif
+    default:
+#ifdef USE_SPINNAKER
+        return std::make_unique<SpinnakerFrameSource>(frameSourceData.serialNumber, frameSourceData.otherSerialNumbers);
+#else
+        std::cout << "CreateFrameSource() Error: Built without the Spinnaker SDK, using the synthetic scene instead" << std::endl;
+        return std::make_unique<SyntheticFrameSource>(frameSourceData);
+#endif
+    }
+}
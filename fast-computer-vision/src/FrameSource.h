@@ -0,0 +1,141 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "FrameSourceData.h"
+#include "ImageConversion.h"
+#include <functional>
+
+enum class ReadoutMode {Full, Binning2x2, Decimation2x2};
+
+// An image as it comes from a frame source.
+// Raw images are Mono8 or Bayer and still need to be converted, any other image is BGR.
+struct SourceImage
+{
+    cv::Mat image;
+    RawPixelFormat rawPixelFormat = RawPixelFormat::Unknown;
+
+    // When the device captured the image on its own clock, in nanoseconds.
+    // It is 0 if the device doesn't timestamp its images.
+    long long timestamp = 0;
+
+    // Goes up by one for every image the device captured, or -1 if the device doesn't count them.
+    long long frameId = -1;
+
+    // Set when Grab() fails because the image arrived damaged
+    bool isIncomplete = false;
+
+    // Set by sources that let the image be kept after Release() without copying it.
+    // The source gets its buffer back once every holder has let go of it.
+    std::shared_ptr<const void> bufferOwner;
+};
+
+// The size of the sensor and the steps a sensor region has to be aligned to
+struct SensorGeometry
+{
+    cv::Size size;
+    cv::Size offsetIncrement = cv::Size(1, 1);
+    cv::Size sizeIncrement = cv::Size(1, 1);
+    cv::Size minimumSize = cv::Size(1, 1);
+};
+
+// Exposure time in microseconds and gain in dB
+struct CameraExposure
+{
+    double exposureTime = 0;
+    double gain = 0;
+};
+
+// Where the camera gets its images from, either camera hardware or recorded footage.
+// Everything except ConfigureGamma() is called from the acquisition thread only.
+// Errors are printed by the source and reported by returning false.
+// ConfigureExposure() turns off the device's own auto exposure, clamps the exposure to what the
+// device supports and returns what was set. It returns false if the source has no exposure to set.
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    virtual bool Open() = 0;
+    virtual void Close() = 0;
+    virtual bool IsOpen() = 0;
+
+    // Binning and decimation reset the sensor region to the full sensor
+    virtual bool ConfigureReadoutMode(ReadoutMode readoutMode, SensorGeometry& sensorGeometry) = 0;
+    virtual bool ConfigureSensorRegion(cv::Rect region) = 0;
+    virtual bool ConfigureGamma(double gamma) = 0;
+    virtual bool ConfigureExposure(CameraExposure& exposure) = 0;
+
+    // The grabbed image stays valid until Release() is called.
+    // In grayscale mode a source should return raw images where it can.
+    virtual bool Grab(SourceImage& sourceImage, bool isGrayscale) = 0;
+    virtual void Release() = 0;
+
+    // Sources that can tell when their device is plugged in call this from their own thread,
+    // so the camera can reconnect right away instead of waiting for its next attempt
+    virtual void SetDeviceArrivalCallback(std::function<void()> callback) {}
+};
+
+// Base class for sources that read full images from somewhere other than a camera.
+// Binning, decimation and the sensor region are done in software so the rest of the
+// pipeline runs exactly as it does with a camera, and frames are paced in real time
+// or handed out as fast as they can be read.
+class SoftwareFrameSource : public FrameSource
+{
+public:
+    SoftwareFrameSource(FramePacing pacing, double frameRate);
+
+    bool ConfigureReadoutMode(ReadoutMode readoutMode, SensorGeometry& sensorGeometry) override;
+    bool ConfigureSensorRegion(cv::Rect region) override;
+    bool ConfigureGamma(double gamma) override;
+    bool ConfigureExposure(CameraExposure& exposure) override;
+    bool Grab(SourceImage& sourceImage, bool isGrayscale) override;
+    void Release() override;
+
+protected:
+    // Size of the full images, which must be known once the source is open
+    virtual cv::Size GetImageSize() = 0;
+    virtual bool ReadImage(SourceImage& sourceImage) = 0;
+    void ResetPacing();
+
+    double frameRate;
+
+private:
+    void WaitForNextFrame();
+
+    FramePacing pacing;
+    long long numImagesRead;
+    ReadoutMode readoutMode;
+    cv::Rect sensorRegion;
+    SourceImage fullImage;
+    cv::Mat colorImage;
+    cv::Mat readoutImage;
+    std::chrono::steady_clock::time_point nextFrameTime;
+};
+
+std::unique_ptr<FrameSource> CreateFrameSource(const FrameSourceData& frameSourceData);
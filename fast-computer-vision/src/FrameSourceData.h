@@ -0,0 +1,59 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+
+enum class FrameSourceType {Spinnaker, Video, ImageSequence, Synthetic, V4L2, Recording};
+enum class FramePacing {RealTime, AsFastAsPossible};
+
+struct FrameSourceData
+{
+    FrameSourceType type = FrameSourceType::Spinnaker;
+    FramePacing pacing = FramePacing::RealTime;
+
+    // A video file, a folder of PNG or JPEG images, a flight recording, or a V4L2 device
+    std::string path;
+
+    // Selects a FLIR camera when there is more than one. The first camera found is used if it is empty,
+    // skipping the cameras that other camera pipelines use.
+    std::string serialNumber;
+    std::vector<std::string> otherSerialNumbers;
+
+    // Image sequences and the synthetic scene play back at this rate in real time.
+    // Videos and flight recordings play back at the rate stored in the file if there is one.
+    double frameRate = 30;
+
+    // The synthetic scene shows every marker in the dictionary
+    cv::Size imageSize = cv::Size(kDefaultImageWidth, kDefaultImageHeight);
+    int markerDictionarySize = 24;
+    int markerNumBits = 4;
+
+    // The synthetic scene can come out as a raw Bayer mosaic, like a color camera sends it,
+    // so the raw conversions can be checked without a camera
+    bool isSyntheticBayer = false;
+};
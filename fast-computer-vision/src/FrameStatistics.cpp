@@ -0,0 +1,100 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "FrameStatistics.h"
+
+SequenceCounter::SequenceCounter() :
+    lastSequenceNumber(-1)
+{
+}
+
+void SequenceCounter::Count(long long sequenceNumber)
+{
+    std::lock_guard<std::mutex> lockGuard(statisticsMutex);
+
+    // A sequence number that goes backward means the stage before restarted,
+    // so there is no gap to count
+    if (lastSequenceNumber >= 0 && sequenceNumber > lastSequenceNumber) {
+        long long gap = sequenceNumber - lastSequenceNumber;
+        statistics.numDropped += gap - 1;
+        statistics.gapHistogram[GetGapBucket(gap)]++;
+    }
+    statistics.numFrames++;
+    lastSequenceNumber = sequenceNumber;
+}
+
+void SequenceCounter::Restart()
+{
+    // Forget the last frame so frames missed while the stage was paused aren't counted as drops
+    std::lock_guard<std::mutex> lockGuard(statisticsMutex);
+    lastSequenceNumber = -1;
+}
+
+void SequenceCounter::Reset()
+{
+    std::lock_guard<std::mutex> lockGuard(statisticsMutex);
+    lastSequenceNumber = -1;
+    statistics = StageStatistics();
+}
+
+StageStatistics SequenceCounter::GetStatistics()
+{
+    std::lock_guard<std::mutex> lockGuard(statisticsMutex);
+    return statistics;
+}
+
+int SequenceCounter::GetGapBucket(long long gap)
+{
+    if (gap <= 4) {
+        return std::max(gap, 1LL) - 1;
+    }
+    else if (gap <= 8) {
+        return 4;
+    }
+    else if (gap <= 16) {
+        return 5;
+    }
+    return 6;
+}
+
+std::string SequenceCounter::GetGapBucketName(int bucket)
+{
+    static const char* kGapBucketNames[kNumGapBuckets] = {"1", "2", "3", "4", "5-8", "9-16", "17+"};
+    return kGapBucketNames[bucket];
+}
+
+std::string FormatGapHistogram(const StageStatistics& statistics)
+{
+    std::stringstream stream;
+    for (int i = 0; i < kNumGapBuckets; i++) {
+        if (i > 0) {
+            stream << ", ";
+        }
+        stream << SequenceCounter::GetGapBucketName(i) << ": " << statistics.gapHistogram[i];
+    }
+    return stream.str();
+}
@@ -0,0 +1,81 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+
+// Gaps between consecutive frames are counted in buckets of 1 (no frames missed),
+// 2, 3, 4, 5-8, 9-16 and more than 16
+const int kNumGapBuckets = 7;
+
+// How many frames one stage of the pipeline processed and how many frames
+// from the stage before it were never processed
+struct StageStatistics
+{
+    long long numFrames = 0;
+    long long numDropped = 0;
+    std::array<long long, kNumGapBuckets> gapHistogram = {};
+};
+
+// Frame counts for the whole pipeline, so drops can be traced to the stage they happened in
+struct FrameStatistics
+{
+    // Camera drops are frames the device captured that never arrived,
+    // because a newer frame replaced them or they were lost on the way
+    StageStatistics camera;
+    long long numIncompleteImages = 0;
+    long long numSkippedImages = 0;
+    long long numStalls = 0;
+
+    // Detection drops are camera frames replaced by a newer one before detection got to them
+    StageStatistics detection;
+
+    // Network drops are detection results replaced by a newer one before they were sent
+    StageStatistics network;
+};
+
+// Counts the frames a stage processes from their sequence numbers, which go up by one for
+// every frame the stage before it produced. It is safe to use from more than one thread.
+class SequenceCounter
+{
+public:
+    SequenceCounter();
+    void Count(long long sequenceNumber);
+    void Restart();
+    void Reset();
+    StageStatistics GetStatistics();
+
+    static int GetGapBucket(long long gap);
+    static std::string GetGapBucketName(int bucket);
+
+private:
+    long long lastSequenceNumber;
+    StageStatistics statistics;
+    std::mutex statisticsMutex;
+};
+
+std::string FormatGapHistogram(const StageStatistics& statistics);
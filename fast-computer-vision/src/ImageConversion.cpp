@@ -0,0 +1,126 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "ImageConversion.h"
+
+// OpenCV names Bayer patterns by the second row, so the GenICam names are shifted by one row.
+// The OpenCV conversions are vectorized, which makes them much faster than a full quality debayer.
+static int GetRawToGrayCode(RawPixelFormat pixelFormat)
+{
+    switch (pixelFormat) {
+    case RawPixelFormat::BayerRG8: return cv::COLOR_BayerBG2GRAY;
+    case RawPixelFormat::BayerGB8: return cv::COLOR_BayerGR2GRAY;
+    case RawPixelFormat::BayerGR8: return cv::COLOR_BayerGB2GRAY;
+    case RawPixelFormat::BayerBG8: return cv::COLOR_BayerRG2GRAY;
+    case RawPixelFormat::YUYV: return cv::COLOR_YUV2GRAY_YUYV;
+    default: return -1;
+    }
+}
+
+static int GetRawToBGRCode(RawPixelFormat pixelFormat)
+{
+    switch (pixelFormat) {
+    case RawPixelFormat::BayerRG8: return cv::COLOR_BayerBG2BGR;
+    case RawPixelFormat::BayerGB8: return cv::COLOR_BayerGR2BGR;
+    case RawPixelFormat::BayerGR8: return cv::COLOR_BayerGB2BGR;
+    case RawPixelFormat::BayerBG8: return cv::COLOR_BayerRG2BGR;
+    case RawPixelFormat::YUYV: return cv::COLOR_YUV2BGR_YUYV;
+    default: return -1;
+    }
+}
+
+void ConvertRawToGray(const cv::Mat& rawImage, RawPixelFormat pixelFormat, cv::Mat& grayImage)
+{
+    if (pixelFormat == RawPixelFormat::Mono8) {
+        grayImage = rawImage;
+        return;
+    }
+
+    int conversionCode = GetRawToGrayCode(pixelFormat);
+    if (conversionCode < 0) {
+        throw std::invalid_argument("ConvertRawToGray() Unsupported pixel format");
+    }
+    cv::cvtColor(rawImage, grayImage, conversionCode);
+}
+
+void ConvertRawToBGR(const cv::Mat& rawImage, RawPixelFormat pixelFormat, cv::Mat& bgrImage)
+{
+    if (pixelFormat == RawPixelFormat::Mono8) {
+        cv::cvtColor(rawImage, bgrImage, cv::COLOR_GRAY2BGR);
+        return;
+    }
+
+    int conversionCode = GetRawToBGRCode(pixelFormat);
+    if (conversionCode < 0) {
+        throw std::invalid_argument("ConvertRawToBGR() Unsupported pixel format");
+    }
+    cv::cvtColor(rawImage, bgrImage, conversionCode);
+}
+
+void GenerateSyntheticBayerImage(const cv::Mat& bgrImage, RawPixelFormat pixelFormat, cv::Mat& rawImage)
+{
+    CV_Assert(bgrImage.type() == CV_8UC3);
+
+    if (pixelFormat == RawPixelFormat::Mono8) {
+        cv::cvtColor(bgrImage, rawImage, cv::COLOR_BGR2GRAY);
+        return;
+    }
+
+    // BGR channel index of each pixel in the repeating 2x2 color filter pattern
+    const int kBlue = 0, kGreen = 1, kRed = 2;
+    int pattern[2][2];
+    switch (pixelFormat) {
+    case RawPixelFormat::BayerRG8:
+        pattern[0][0] = kRed;   pattern[0][1] = kGreen;
+        pattern[1][0] = kGreen; pattern[1][1] = kBlue;
+        break;
+    case RawPixelFormat::BayerGB8:
+        pattern[0][0] = kGreen; pattern[0][1] = kBlue;
+        pattern[1][0] = kRed;   pattern[1][1] = kGreen;
+        break;
+    case RawPixelFormat::BayerGR8:
+        pattern[0][0] = kGreen; pattern[0][1] = kRed;
+        pattern[1][0] = kBlue;  pattern[1][1] = kGreen;
+        break;
+    case RawPixelFormat::BayerBG8:
+        pattern[0][0] = kBlue;  pattern[0][1] = kGreen;
+        pattern[1][0] = kGreen; pattern[1][1] = kRed;
+        break;
+    default:
+        throw std::invalid_argument("GenerateSyntheticBayerImage() Unsupported pixel format");
+    }
+
+    rawImage.create(bgrImage.size(), CV_8UC1);
+    for (int y = 0; y < bgrImage.rows; y++) {
+        const cv::Vec3b* bgrRow = bgrImage.ptr<cv::Vec3b>(y);
+        uchar* rawRow = rawImage.ptr<uchar>(y);
+        const int* patternRow = pattern[y % 2];
+        for (int x = 0; x < bgrImage.cols; x++) {
+            rawRow[x] = bgrRow[x][patternRow[x % 2]];
+        }
+    }
+}
@@ -0,0 +1,48 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+
+// Pixel layouts that can be converted straight from a camera buffer.
+// Bayer names follow the GenICam convention used by the camera (the color of
+// the first two pixels of the first row), not the OpenCV convention.
+// YUYV is the packed 4:2:2 layout used by UVC cameras, stored as a 2 channel image.
+enum class RawPixelFormat {Unknown, Mono8, BayerRG8, BayerGB8, BayerGR8, BayerBG8, YUYV};
+
+// Builds a single channel image directly from a raw Mono8, Bayer or YUYV buffer.
+// Mono8 is passed through without a copy, Bayer is demosaiced straight to
+// grayscale and YUYV keeps only its Y samples, which skips building the 3 channel
+// color image entirely.
+void ConvertRawToGray(const cv::Mat& rawImage, RawPixelFormat pixelFormat, cv::Mat& grayImage);
+
+// Builds a 3 channel BGR image from a raw Mono8, Bayer or YUYV buffer.
+void ConvertRawToBGR(const cv::Mat& rawImage, RawPixelFormat pixelFormat, cv::Mat& bgrImage);
+
+// Samples a BGR image into a raw Bayer mosaic, as a camera sensor would.
+// The synthetic frame source uses it to check the raw conversions without a camera.
+void GenerateSyntheticBayerImage(const cv::Mat& bgrImage, RawPixelFormat pixelFormat, cv::Mat& rawImage);
@@ -0,0 +1,116 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "ImageSequenceFrameSource.h"
+
+ImageSequenceFrameSource::ImageSequenceFrameSource(std::string path, FramePacing pacing, double frameRate) :
+    SoftwareFrameSource(pacing, frameRate),
+    path(path),
+    imageIndex(0)
+{
+}
+
+bool ImageSequenceFrameSource::Open()
+{
+    imagePaths.clear();
+    imageIndex = 0;
+
+    try {
+        std::vector<cv::String> filePaths;
+        cv::glob(path, filePaths, false);
+        for (const cv::String& filePath : filePaths) {
+            std::string extension = filePath.substr(filePath.find_last_of('.') + 1);
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                [](unsigned char c) { return std::tolower(c); });
+            if (extension == "png" || extension == "jpg" || extension == "jpeg") {
+                imagePaths.push_back(filePath);
+            }
+        }
+
+        if (imagePaths.empty()) {
+            std::cout << "Open() Error: No PNG or JPEG images in " << path << std::endl;
+            return false;
+        }
+
+        sequenceImage = cv::imread(imagePaths[0], cv::IMREAD_ANYCOLOR);
+        if (sequenceImage.empty()) {
+            std::cout << "Open() Error: Unable to read image " << imagePaths[0] << std::endl;
+            imagePaths.clear();
+            return false;
+        }
+        imageSize = sequenceImage.size();
+    }
+    catch (cv::Exception& exception) {
+        std::cout << "Open() Error: " << exception.what() << std::endl;
+        imagePaths.clear();
+        return false;
+    }
+
+    std::cout << "Image Sequence: " << path << ", " << imagePaths.size() << " images, "
+        << imageSize.width << " x " << imageSize.height << std::endl;
+    ResetPacing();
+    return true;
+}
+
+void ImageSequenceFrameSource::Close()
+{
+    imagePaths.clear();
+    sequenceImage.release();
+}
+
+bool ImageSequenceFrameSource::IsOpen()
+{
+    return !imagePaths.empty();
+}
+
+cv::Size ImageSequenceFrameSource::GetImageSize()
+{
+    return imageSize;
+}
+
+bool ImageSequenceFrameSource::ReadImage(SourceImage& sourceImage)
+{
+    // Images are decoded as they are needed so long sequences don't have to fit in memory
+    const cv::String& imagePath = imagePaths[imageIndex];
+    imageIndex = (imageIndex + 1) % imagePaths.size();
+
+    try {
+        sequenceImage = cv::imread(imagePath, cv::IMREAD_ANYCOLOR);
+    }
+    catch (cv::Exception& exception) {
+        std::cout << "ReadImage() Error: " << exception.what() << std::endl;
+        return false;
+    }
+    if (sequenceImage.empty() || sequenceImage.size() != imageSize) {
+        std::cout << "ReadImage() Error: Skipping image " << imagePath << std::endl;
+        return false;
+    }
+
+    sourceImage.image = sequenceImage;
+    sourceImage.rawPixelFormat = (sequenceImage.channels() == 1) ? RawPixelFormat::Mono8 : RawPixelFormat::Unknown;
+    return true;
+}
@@ -0,0 +1,53 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "FrameSource.h"
+
+// Plays back the PNG and JPEG images in a folder in file name order, starting over
+// after the last one. Every image must be the same size as the first one.
+class ImageSequenceFrameSource : public SoftwareFrameSource
+{
+public:
+    ImageSequenceFrameSource(std::string path, FramePacing pacing, double frameRate);
+
+    bool Open() override;
+    void Close() override;
+    bool IsOpen() override;
+
+protected:
+    cv::Size GetImageSize() override;
+    bool ReadImage(SourceImage& sourceImage) override;
+
+private:
+    std::string path;
+    std::vector<cv::String> imagePaths;
+    size_t imageIndex;
+    cv::Size imageSize;
+    cv::Mat sequenceImage;
+};
@@ -39,3 +39,13 @@ struct MarkerData
     float bottomLeft[2];
     float bottomRight[2];
 };
+
+// The markers found in one frame
+struct TrackingData
+{
+    // Goes up by one for every frame detection finishes
+    unsigned int sequenceNumber = 0;
+    unsigned int frameNumber = 0;
+    std::chrono::system_clock::time_point captureTime;
+    std::map<int, MarkerData> markers;
+};
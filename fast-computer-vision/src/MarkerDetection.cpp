@@ -26,27 +26,40 @@
 //=============================================================================
 
 #include "MarkerDetection.h"
+#include "Calibration.h"
+#include "MarkerSearch.h"
+
+// The smallest padding around a marker's last position when only searching near it, in pixels
+static const int kMinSearchWindowPadding = 16;
+
+// The fewest pixels per cell a marker needs in the image searched for its bits to be read
+static const double kMinPixelsPerCell = 2.0;
 
 MarkerDetection::MarkerDetection(Camera& camera) :
     camera(camera),
     isDetected(false),
     currentFrameNumber(0),
     lastFrameNumber(0),
-    markerCorners(0),
+    frameSequenceNumber(0),
+    orientationTransform(cv::Matx33d::eye()),
+    detectorParametersVersion(1),
+    appliedDetectorParametersVersion(0),
+    isRoiTracking(false),
+    fullScanInterval(10),
+    numFramesSinceFullScan(0),
+    pyramidLevel(0),
+    tileMarkerSize(0),
+    minMarkerSize(0),
 	rejectedCandidates(0),
-    markerIds(0)
+    numDetectionWorkers(1),
+    maxJobsInFlight(1),
+    isWorkerRunning(false),
+    isPublishing(false)
 {
-
-    camera.CopyImageTo(inputImage);
-
-	{
-        std::lock_guard<std::mutex> lockGuard(outputImageMutex);
-		inputImage.copyTo(outputImage);
-	}
-
-    markerDictionary = cv::aruco::generateCustomDictionary(
-        detectorParameters.markerDictionarySize,
-        detectorParameters.markerNumBits);
+    // The dictionary is empty until it has been generated in the background,
+    // which keeps the slow generation out of startup
+    detectorParameters = std::make_shared<const DetectorParameterData>();
+    markerDictionary = cv::makePtr<cv::aruco::Dictionary>();
 	refineParameters = cv::aruco::RefineParameters::create();
 	markerParameters = cv::aruco::DetectorParameters::create();
 
@@ -55,73 +68,129 @@ MarkerDetection::MarkerDetection(Camera& camera) :
 
 MarkerDetection::~MarkerDetection()
 {
+    StartWorkers(0);
 }
 
 void MarkerDetection::Pause()
 {
     frameRateTimer.Reset();
+    frameCounter.Restart();
+    previousMarkerIds.clear();
+    previousMarkerCorners.clear();
+
+    // The last markers are dropped so tracking merged from other cameras doesn't keep them
+    {
+        std::lock_guard<std::mutex> lockGuard(trackingDataMutex);
+        if (!trackingData.markers.empty()) {
+            trackingData.markers.clear();
+            trackingData.sequenceNumber++;
+        }
+    }
+
+    // Workers stop taking frames, and the frames they already took are never published
+    std::lock_guard<std::mutex> lockGuard(jobsMutex);
+    isPublishing = false;
+    jobs.clear();
 }
 
 void MarkerDetection::Run()
 {
-    currentFrameNumber = camera.GetFrameNumber();
-    if (lastFrameNumber == currentFrameNumber) {
+    // Workers are only started and stopped here, so they never change while frames are taken
+    int numWorkers = numDetectionWorkers;
+    int numWorkerThreads = (numWorkers > 1) ? numWorkers : 0;
+    if (numWorkerThreads != detectionWorkers.size()) {
+        StartWorkers(numWorkerThreads);
+    }
+    if (!detectionWorkers.empty()) {
+        PublishNextJob();
         return;
     }
 
-    executionTimer.Start();
-
-    camera.CopyImageTo(inputImage);
+    // Wait for a frame newer than the last one detected. The camera acquires on its own thread,
+    // so this picks up the freshest frame instead of waiting for the next exposure.
+    // The frame is shared with the camera and the GUI, so it is only read and never copied.
+    std::shared_ptr<const FrameData> frame = camera.WaitForOutputFrame(frameSequenceNumber, 100);
+    if (frame == nullptr) {
+        return;
+    }
 
-    markerCorners.clear();
-    markerIds.clear();
-    rejectedCandidates.clear();
+    executionTimer.Start();
+    TakeFrame(frame, detectionJob);
+    DetectMarkers(detectionJob, rejectedCandidates, pyramidImage, true);
+    PublishFrame(detectionJob);
+    executionTimer.Stop();
+    //std::cout << "Detection processing: " << executionTimer.duration << " ms" << std::endl;
+}
 
+void MarkerDetection::TakeFrame(std::shared_ptr<const FrameData> frame, DetectionJob& job)
+{
+    job.frame = frame;
+    job.markerCorners.clear();
+    job.markerIds.clear();
+    job.isDone = false;
+    frameCounter.Count(frame->frameNumber);
+
+    // The detector is only rebuilt when the parameters or the dictionary change. Each frame
+    // keeps the detector it was taken with, so a change never reaches a frame half way through.
+    UpdateDetector();
+    job.detector = arucoDetector;
+    job.parameters = appliedDetectorParameters;
+    job.isDictionaryReady = !markerDictionary->bytesList.empty();
+    job.pyramidLevel = pyramidLevel;
+    job.tileMarkerSize = tileMarkerSize;
+
+    // The image may only cover part of the full camera image when the camera reads out
+    // a region of the sensor, but marker coordinates are always normalized to the full image.
+    const cv::Mat& inputImage = frame->image;
+    cv::Size fullSize = frame->fullSize;
+    cv::Point2d imageOffset(frame->region.x, frame->region.y);
+
+    // Detection runs on the image in the orientation of the sensor
+    cv::Rect2d trackingAreaInPixels;
+    job.outputSize = fullSize;
     {
-        std::lock_guard<std::mutex> lockGuard(detectorParametersMutex);
-        markerParameters->adaptiveThreshWinSizeMin = detectorParameters.adaptiveThreshWinSizeMin;
-        markerParameters->adaptiveThreshWinSizeMax = detectorParameters.adaptiveThreshWinSizeMax;
-        markerParameters->adaptiveThreshWinSizeStep = detectorParameters.adaptiveThreshWinSizeStep;
-        markerParameters->adaptiveThreshConstant = detectorParameters.adaptiveThreshConstant;
-
-        markerParameters->minMarkerPerimeterRate = detectorParameters.minMarkerPerimeterRate;
-        markerParameters->maxMarkerPerimeterRate = detectorParameters.maxMarkerPerimeterRate;
-        markerParameters->polygonalApproxAccuracyRate = detectorParameters.polygonalApproxAccuracyRate;
-        markerParameters->minCornerDistanceRate = detectorParameters.minCornerDistanceRate;
-        markerParameters->minMarkerDistanceRate = detectorParameters.minMarkerDistanceRate;
-        markerParameters->minDistanceToBorder = detectorParameters.minDistanceToBorder;
-
-        markerParameters->markerBorderBits = detectorParameters.markerBorderBits;
-        markerParameters->minOtsuStdDev = detectorParameters.minOtsuStdDev;
-        markerParameters->perspectiveRemovePixelPerCell = detectorParameters.perspectiveRemovePixelPerCell;
-        markerParameters->perspectiveRemoveIgnoredMarginPerCell = detectorParameters.perspectiveRemoveIgnoredMarginPerCell;
-
-        markerParameters->maxErroneousBitsInBorderRate = detectorParameters.maxErroneousBitsInBorderRate;
-        markerParameters->errorCorrectionRate = detectorParameters.errorCorrectionRate;
-
-        if (markerDictionary->bytesList.rows != detectorParameters.markerDictionarySize ||
-            markerDictionary->markerSize != detectorParameters.markerNumBits)
+        std::lock_guard<std::mutex> lockGuard(trackingAreaMutex);
+        trackingAreaInPixels = cv::Rect2d(sensorTrackingArea.x * fullSize.width,
+            sensorTrackingArea.y * fullSize.height,
+            sensorTrackingArea.width * fullSize.width,
+            sensorTrackingArea.height * fullSize.height);
+        job.transform = orientationTransform;
+        if (orientationData.rotation == OrientationRotation::Rotate90 ||
+            orientationData.rotation == OrientationRotation::Rotate270)
         {
-            markerDictionary = cv::aruco::generateCustomDictionary(
-                detectorParameters.markerDictionarySize,
-                detectorParameters.markerNumBits);
+            job.outputSize = cv::Size(fullSize.height, fullSize.width);
         }
-        arucoDetector = cv::aruco::ArucoDetector(markerDictionary, markerParameters, refineParameters);
     }
 
-    cv::Rect2d trackingAreaInPixels;
-    {
-        std::lock_guard<std::mutex> lockGuard(trackingAreaMutex);
-        trackingAreaInPixels = cv::Rect2d(trackingArea.x * inputImage.cols,
-            trackingArea.y * inputImage.rows,
-            trackingArea.width * inputImage.cols,
-            trackingArea.height * inputImage.rows);
+    // Crop the tracking area relative to where the image is in the full camera image
+    // When the image is still distorted the tracking area doesn't line up with it, so detection
+    // runs on the whole image and markers are kept if their undistorted center is in the tracking area.
+    // The camera only reads out the part of the sensor that the tracking area comes from.
+    job.isUndistortPoints = !frame->undistortPointMap.empty();
+    job.undistortedTrackingArea = trackingAreaInPixels;
+    if (job.isUndistortPoints) {
+        trackingAreaInPixels = cv::Rect2d(0, 0, inputImage.cols, inputImage.rows);
     }
-
-    trackingImage = inputImage(trackingAreaInPixels);
-    if (!trackingImage.empty()) {
-        arucoDetector.detectMarkers(trackingImage, markerCorners, markerIds, rejectedCandidates);
+    else {
+        trackingAreaInPixels = (trackingAreaInPixels - imageOffset) & cv::Rect2d(0, 0, inputImage.cols, inputImage.rows);
     }
+    job.trackingAreaInPixels = trackingAreaInPixels;
+    job.trackingAreaOffset = cv::Point2d(trackingAreaInPixels.x + imageOffset.x, trackingAreaInPixels.y + imageOffset.y);
+}
+
+void MarkerDetection::PublishFrame(const DetectionJob& job)
+{
+    const std::vector<std::vector<cv::Point2f>>& markerCorners = job.markerCorners;
+    const std::vector<int>& markerIds = job.markerIds;
+    const cv::Mat& undistortPointMap = job.frame->undistortPointMap;
+    bool isUndistortPoints = job.isUndistortPoints;
+    cv::Rect2d undistortedTrackingArea = job.undistortedTrackingArea;
+    cv::Point2d trackingAreaOffset = job.trackingAreaOffset;
+    cv::Matx33d transform = job.transform;
+    cv::Size fullSize = job.frame->fullSize;
+    cv::Size outputSize = job.outputSize;
+    cv::Mat trackingImage = job.frame->image(job.trackingAreaInPixels);
+    currentFrameNumber = job.frame->frameNumber;
 
 	try {
 		isDetected = ((int)markerIds.size() > 0);
@@ -130,12 +199,20 @@ void MarkerDetection::Run()
 		isDetected = false;
 	}
 
+    // Markers that suddenly disappear can trigger a flight recorder dump
+    camera.GetFlightRecorder().UpdateMarkerCount((int)markerIds.size());
+
+    // The contrast of the markers that were found steers the camera's exposure
+    camera.GetExposureController().Measure(trackingImage, markerCorners, currentFrameNumber);
+
 	{
         std::lock_guard<std::mutex> lockGuard(trackingDataMutex);
-        trackingData.clear();
+        trackingData.markers.clear();
+        trackingData.sequenceNumber++;
+        trackingData.frameNumber = job.frame->frameNumber;
+        trackingData.captureTime = job.frame->captureTime;
 
 		if (isDetected) {
-            cv::Point2d trackingAreaOffset(trackingAreaInPixels.x, trackingAreaInPixels.y);
 			int numMarkers = markerIds.size();
 
 			for (int i = 0; i < numMarkers; i++) {
@@ -145,18 +222,35 @@ void MarkerDetection::Run()
                 markerData.id = markerIds[i];
 
                 // Corners
+                // Each corner is moved into the full camera image, undistorted if the image wasn't,
+                // and then turned to the orientation of the table, so the center, angle and size
+                // below are measured on the table.
 				std::vector<cv::Point2f> corners = markerCorners[i];
-                markerData.topLeft[0] = (corners[0].x + trackingAreaOffset.x) / outputImage.cols;
-                markerData.topLeft[1] = (corners[0].y + trackingAreaOffset.y) / outputImage.rows;
-
-                markerData.topRight[0] = (corners[1].x + trackingAreaOffset.x) / outputImage.cols;
-                markerData.topRight[1] = (corners[1].y + trackingAreaOffset.y) / outputImage.rows;
-
-                markerData.bottomRight[0] = (corners[2].x + trackingAreaOffset.x) / outputImage.cols;
-                markerData.bottomRight[1] = (corners[2].y + trackingAreaOffset.y) / outputImage.rows;
-
-                markerData.bottomLeft[0] = (corners[3].x + trackingAreaOffset.x) / outputImage.cols;
-                markerData.bottomLeft[1] = (corners[3].y + trackingAreaOffset.y) / outputImage.rows;
+                cv::Point2f undistortedCenter;
+                for (int j = 0; j < corners.size(); j++) {
+                    cv::Point2f corner(corners[j].x + trackingAreaOffset.x, corners[j].y + trackingAreaOffset.y);
+                    if (isUndistortPoints) {
+                        corner = Calibration::UndistortPoint(undistortPointMap, corner);
+                    }
+                    undistortedCenter += corner / float(corners.size());
+
+                    cv::Vec3d point = transform * cv::Vec3d(corner.x / fullSize.width, corner.y / fullSize.height, 1);
+                    corners[j] = cv::Point2f(point[0] * outputSize.width, point[1] * outputSize.height);
+                }
+                if (isUndistortPoints && !undistortedTrackingArea.contains(cv::Point2d(undistortedCenter))) {
+                    continue;
+                }
+                markerData.topLeft[0] = corners[0].x / outputSize.width;
+                markerData.topLeft[1] = corners[0].y / outputSize.height;
+
+                markerData.topRight[0] = corners[1].x / outputSize.width;
+                markerData.topRight[1] = corners[1].y / outputSize.height;
+
+                markerData.bottomRight[0] = corners[2].x / outputSize.width;
+                markerData.bottomRight[1] = corners[2].y / outputSize.height;
+
+                markerData.bottomLeft[0] = corners[3].x / outputSize.width;
+                markerData.bottomLeft[1] = corners[3].y / outputSize.height;
 
                 // Center point
                 cv::Point2f center;
@@ -164,8 +258,8 @@ void MarkerDetection::Run()
 					center += corners[j];
 				}
 				center /= float(markerCorners[i].size());
-                markerData.center[0] = (center.x + trackingAreaOffset.x) / outputImage.cols;
-                markerData.center[1] = (center.y + trackingAreaOffset.y) / outputImage.rows;
+                markerData.center[0] = center.x / outputSize.width;
+                markerData.center[1] = center.y / outputSize.height;
 
                 // Angle
 				cv::Point2f pointA((corners[1] + corners[2]) * 0.5);
@@ -185,47 +279,328 @@ void MarkerDetection::Run()
 
                 // Size
                 // Normalized as a square area
-                markerData.size = (4 * radius * radius) / (outputImage.cols * outputImage.rows);
+                markerData.size = (4 * radius * radius) / (outputSize.width * outputSize.height);
 
 
-                trackingData[markerData.id] = markerData;
+                trackingData.markers[markerData.id] = markerData;
 			}
         }
     }
 
     {
         std::lock_guard<std::mutex> lockGuard(outputImageMutex);
-        inputImage.copyTo(outputImage);
+        outputFrame = job.frame;
     }
     lastFrameNumber = currentFrameNumber;
+    minMarkerSize = CalculateMinMarkerSize(*job.parameters, trackingImage.size(), job.pyramidLevel);
 
     frameRateTimer.Update();
-    executionTimer.Stop();
-    //std::cout << "Detection processing: " << executionTimer.duration << " ms" << std::endl;
+}
+
+void MarkerDetection::DetectMarkers(DetectionJob& job, std::vector<std::vector<cv::Point2f>>& rejectedCandidates,
+    cv::Mat& pyramidImage, bool isNearbySearch)
+{
+    cv::Mat trackingImage = job.frame->image(job.trackingAreaInPixels);
+    if (trackingImage.empty() || !job.isDictionaryReady) {
+        return;
+    }
+
+    // Markers only move a few pixels between frames, so most frames only search padded windows
+    // around the markers found in the last frame. The whole tracking area is searched every
+    // few frames to find new markers, and right away when a marker isn't found in its window.
+    // Frames detected at the same time on workers don't know the last frame's markers, so they
+    // always search the whole tracking area.
+    std::vector<std::vector<cv::Point2f>>& markerCorners = job.markerCorners;
+    std::vector<int>& markerIds = job.markerIds;
+    cv::Size fullSize = job.frame->fullSize;
+    bool isFullScan = !isNearbySearch || !isRoiTracking || numFramesSinceFullScan + 1 >= fullScanInterval ||
+        previousMarkerIds.empty() || fullSize != previousFullSize;
+
+    if (!isFullScan) {
+        std::vector<cv::Rect> searchWindows = GetSearchWindows(trackingImage.size(), job.trackingAreaOffset);
+        for (int i = 0; i < searchWindows.size(); i++) {
+            DetectMarkersPyramid(job.detector, trackingImage(searchWindows[i]), job.pyramidLevel,
+                windowMarkerCorners, windowMarkerIds, rejectedCandidates, pyramidImage);
+            cv::Point2f windowOffset(searchWindows[i].x, searchWindows[i].y);
+            for (int j = 0; j < windowMarkerIds.size(); j++) {
+                for (int k = 0; k < windowMarkerCorners[j].size(); k++) {
+                    windowMarkerCorners[j][k] += windowOffset;
+                }
+                markerCorners.push_back(windowMarkerCorners[j]);
+                markerIds.push_back(windowMarkerIds[j]);
+            }
+        }
+
+        for (int i = 0; i < previousMarkerIds.size() && !isFullScan; i++) {
+            isFullScan = (std::find(markerIds.begin(), markerIds.end(), previousMarkerIds[i]) == markerIds.end());
+        }
+    }
+
+    if (isFullScan) {
+        if (job.tileMarkerSize > 0) {
+            DetectMarkersTiled(job.detector, trackingImage, job.pyramidLevel, job.tileMarkerSize,
+                job.parameters->minMarkerPerimeterRate, markerCorners, markerIds);
+        }
+        else {
+            DetectMarkersPyramid(job.detector, trackingImage, job.pyramidLevel,
+                markerCorners, markerIds, rejectedCandidates, pyramidImage);
+        }
+    }
+    if (!isNearbySearch) {
+        return;
+    }
+
+    if (isFullScan) {
+        numFramesSinceFullScan = 0;
+    }
+    else {
+        numFramesSinceFullScan++;
+    }
+
+    // Windows are placed in the full camera image because the tracking area and the sensor region
+    // can move between frames
+    previousMarkerIds = markerIds;
+    previousMarkerCorners = markerCorners;
+    for (int i = 0; i < previousMarkerCorners.size(); i++) {
+        for (int j = 0; j < previousMarkerCorners[i].size(); j++) {
+            previousMarkerCorners[i][j] += cv::Point2f(job.trackingAreaOffset);
+        }
+    }
+    previousFullSize = fullSize;
+}
+
+void MarkerDetection::StartWorkers(int numWorkers)
+{
+    {
+        std::lock_guard<std::mutex> lockGuard(jobsMutex);
+        isWorkerRunning = false;
+    }
+    jobCondition.notify_all();
+    for (int i = 0; i < detectionWorkers.size(); i++) {
+        detectionWorkers[i].join();
+    }
+    detectionWorkers.clear();
+    jobs.clear();
+
+    isWorkerRunning = true;
+    for (int i = 0; i < numWorkers; i++) {
+        detectionWorkers.push_back(std::thread(&MarkerDetection::RunWorker, this));
+    }
+}
+
+void MarkerDetection::RunWorker()
+{
+    // Each worker keeps its own buffers from frame to frame
+    std::vector<std::vector<cv::Point2f>> workerRejectedCandidates;
+    cv::Mat workerPyramidImage;
+
+    while (isWorkerRunning) {
+        // Workers take frames one at a time so the jobs queue up in frame order, and only
+        // while Run() is publishing results and the queue has room for another frame
+        std::shared_ptr<DetectionJob> job;
+        {
+            std::lock_guard<std::mutex> takeLockGuard(takeFrameMutex);
+            {
+                std::unique_lock<std::mutex> lock(jobsMutex);
+                bool isRoom = jobCondition.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+                    return !isWorkerRunning || (isPublishing && jobs.size() < maxJobsInFlight);
+                });
+                if (!isRoom || !isWorkerRunning) {
+                    continue;
+                }
+            }
+
+            std::shared_ptr<const FrameData> frame = camera.WaitForOutputFrame(frameSequenceNumber, 100);
+            if (frame == nullptr) {
+                continue;
+            }
+            job = std::make_shared<DetectionJob>();
+            TakeFrame(frame, *job);
+
+            std::lock_guard<std::mutex> lockGuard(jobsMutex);
+            jobs.push_back(job);
+        }
+
+        DetectMarkers(*job, workerRejectedCandidates, workerPyramidImage, false);
+
+        {
+            std::lock_guard<std::mutex> lockGuard(jobsMutex);
+            job->isDone = true;
+        }
+        jobCondition.notify_all();
+    }
+}
+
+void MarkerDetection::PublishNextJob()
+{
+    // Results are published strictly in frame order. A frame that finished early waits for
+    // the frames before it, and the workers stop taking frames while the queue is full.
+    std::shared_ptr<DetectionJob> job;
+    {
+        std::unique_lock<std::mutex> lock(jobsMutex);
+        isPublishing = true;
+        jobCondition.notify_all();
+        bool isReady = jobCondition.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+            return !jobs.empty() && jobs.front()->isDone;
+        });
+        if (!isReady) {
+            return;
+        }
+        job = jobs.front();
+        jobs.pop_front();
+    }
+    jobCondition.notify_all();
+
+    PublishFrame(*job);
+}
+
+int MarkerDetection::CalculateMinMarkerSize(const DetectorParameterData& parameters, cv::Size imageSize, int pyramidLevel)
+{
+    // A marker is too small if its perimeter is below the minimum rate of the image size,
+    // which doesn't depend on the pyramid level, or if its cells are too few pixels wide
+    // in the downscaled image to be read
+    int level = std::min(std::max(pyramidLevel, 0), kMaxPyramidLevel);
+    double sizeFromPerimeter = parameters.minMarkerPerimeterRate * std::max(imageSize.width, imageSize.height) / 4.0;
+    int numCells = parameters.markerNumBits + 2 * parameters.markerBorderBits;
+    double sizeFromCells = kMinPixelsPerCell * numCells * (1 << level);
+    return (int)std::ceil(std::max(sizeFromPerimeter, sizeFromCells));
+}
+
+std::vector<cv::Rect> MarkerDetection::GetSearchWindows(cv::Size imageSize, cv::Point2d trackingAreaOffset)
+{
+    // Each window is the marker padded by its own size on every side. That leaves room for
+    // the marker to move and keeps it small enough in the window for the perimeter limits,
+    // which are relative to the size of the image searched. Overlapping windows are merged
+    // so no marker is found twice.
+    cv::Rect imageArea(cv::Point(0, 0), imageSize);
+    std::vector<cv::Rect> searchWindows;
+    for (int i = 0; i < previousMarkerCorners.size(); i++) {
+        std::vector<cv::Point2f> corners = previousMarkerCorners[i];
+        for (int j = 0; j < corners.size(); j++) {
+            corners[j] -= cv::Point2f(trackingAreaOffset);
+        }
+        cv::Rect markerArea = cv::boundingRect(corners);
+        int padding = std::max(std::max(markerArea.width, markerArea.height), kMinSearchWindowPadding);
+        cv::Rect searchWindow(markerArea.x - padding, markerArea.y - padding,
+            markerArea.width + 2 * padding, markerArea.height + 2 * padding);
+        searchWindow &= imageArea;
+        if (!searchWindow.empty()) {
+            searchWindows.push_back(searchWindow);
+        }
+    }
+
+    for (int i = 0; i < searchWindows.size(); i++) {
+        for (int j = i + 1; j < searchWindows.size(); j++) {
+            if ((searchWindows[i] & searchWindows[j]).area() > 0) {
+                searchWindows[i] |= searchWindows[j];
+                searchWindows.erase(searchWindows.begin() + j);
+                j = i;
+            }
+        }
+    }
+
+    return searchWindows;
 }
 
 void MarkerDetection::CopyImageTo(cv::Mat& destinationImage)
 {
-    cv::Mat guiImage;
+    std::shared_ptr<const FrameData> guiFrame;
     {
         std::lock_guard<std::mutex> lockGuard(outputImageMutex);
-        outputImage.copyTo(guiImage);
+        guiFrame = outputFrame;
+    }
+
+    if (guiFrame == nullptr) {
+        destinationImage = cv::Mat::zeros(camera.GetResolution(), CV_8UC3);
+        return;
+    }
+
+    OrientationData orientation;
+    cv::Matx33d transform;
+    {
+        std::lock_guard<std::mutex> lockGuard(trackingAreaMutex);
+        orientation = orientationData;
+        transform = orientationTransform;
+    }
+    bool isOriented = (transform != cv::Matx33d::eye());
+
+    // This is the only copy of the frame and it's needed so the guides can be drawn on it.
+    // In grayscale mode the frame has no color left, so the gray image is only spread to
+    // 3 channels here for the colored guides and markers drawn on top of it.
+    // The image is placed where it belongs in the full camera image, which is black outside
+    // the sensor region.
+    cv::Size fullSize = guiFrame->fullSize;
+    cv::Mat sensorImage;
+    cv::Mat& fullImage = isOriented ? sensorImage : destinationImage;
+    fullImage.create(fullSize, CV_8UC3);
+    if (guiFrame->region.size() != fullSize) {
+        fullImage.setTo(cv::Scalar::all(0));
+    }
+    cv::Mat regionImage = fullImage(guiFrame->region);
+    if (guiFrame->image.channels() == 1) {
+        cv::cvtColor(guiFrame->image, regionImage, cv::COLOR_GRAY2BGR);
+    }
+    else {
+        guiFrame->image.copyTo(regionImage);
+    }
+
+    // The image is only turned to the orientation of the table here, when it is shown,
+    // so the guides and markers line up with it
+    if (isOriented) {
+        bool isAffine = (orientation.affine != cv::Matx23d(1, 0, 0, 0, 1, 0));
+        cv::Size outputSize = fullSize;
+        int rotateCode = -1;
+        if (orientation.rotation == OrientationRotation::Rotate90) {
+            outputSize = cv::Size(fullSize.height, fullSize.width);
+            rotateCode = cv::ROTATE_90_CLOCKWISE;
+        }
+        else if (orientation.rotation == OrientationRotation::Rotate180) {
+            rotateCode = cv::ROTATE_180;
+        }
+        else if (orientation.rotation == OrientationRotation::Rotate270) {
+            outputSize = cv::Size(fullSize.height, fullSize.width);
+            rotateCode = cv::ROTATE_90_COUNTERCLOCKWISE;
+        }
+
+        if (!isAffine && !orientation.isMirrored) {
+            cv::rotate(sensorImage, destinationImage, rotateCode);
+        }
+        else if (!isAffine && rotateCode == -1) {
+            cv::flip(sensorImage, destinationImage, 1);
+        }
+        else {
+            cv::Matx33d pixelTransform =
+                cv::Matx33d(outputSize.width, 0, 0, 0, outputSize.height, 0, 0, 0, 1) * transform *
+                cv::Matx33d(1.0 / fullSize.width, 0, 0, 0, 1.0 / fullSize.height, 0, 0, 0, 1);
+            cv::warpAffine(sensorImage, destinationImage, pixelTransform.get_minor<2, 3>(0, 0), outputSize);
+        }
     }
 
-    DrawGuides(guiImage);
-    DrawMarkers(guiImage);
-    guiImage.copyTo(destinationImage);
+    DrawGuides(destinationImage);
+    DrawMarkers(destinationImage);
 }
 
 bool MarkerDetection::GenerateMarkerImages(int imageSize)
 {
-    std::lock_guard<std::mutex> lockGuard(detectorParametersMutex);
+    std::shared_ptr<const DetectorParameterData> parameters = std::atomic_load(&detectorParameters);
+    cv::Ptr<cv::aruco::Dictionary> dictionary;
+    {
+        std::lock_guard<std::mutex> lockGuard(dictionaryMutex);
+        dictionary = markerDictionary;
+    }
 
     bool isImagesSaved = false;
     cv::Mat markerImage;
     try {
-        for (int i = 0; i < detectorParameters.markerDictionarySize; i++) {
-            cv::aruco::drawMarker(markerDictionary, i, imageSize, markerImage, 1);
+        // Detection may still be generating the dictionary for new parameters
+        if (dictionary->bytesList.rows != parameters->markerDictionarySize ||
+            dictionary->markerSize != parameters->markerNumBits)
+        {
+            dictionary = cv::aruco::generateCustomDictionary(parameters->markerDictionarySize, parameters->markerNumBits);
+        }
+
+        for (int i = 0; i < parameters->markerDictionarySize; i++) {
+            cv::aruco::drawMarker(dictionary, i, imageSize, markerImage, 1);
             cv::imwrite(cv::format("markers/marker-%d.png", i), markerImage);
         }
         isImagesSaved = true;
@@ -237,17 +612,32 @@ bool MarkerDetection::GenerateMarkerImages(int imageSize)
     return isImagesSaved;
 }
 
-std::map<int, MarkerData> MarkerDetection::GetTrackingData()
+TrackingData MarkerDetection::GetTrackingData()
 {
     std::lock_guard<std::mutex> lockGuard(trackingDataMutex);
     return trackingData;
 }
 
+bool MarkerDetection::GetIsDetected()
+{
+    return isDetected;
+}
+
 double MarkerDetection::GetFrameRate()
 {
     return frameRateTimer.frameRate;
 }
 
+StageStatistics MarkerDetection::GetStatistics()
+{
+    return frameCounter.GetStatistics();
+}
+
+void MarkerDetection::ResetStatistics()
+{
+    frameCounter.Reset();
+}
+
 unsigned int MarkerDetection::GetFrameNumber()
 {
     return currentFrameNumber;
@@ -255,14 +645,196 @@ unsigned int MarkerDetection::GetFrameNumber()
 
 void MarkerDetection::UpdateTrackingArea(cv::Rect2d trackingArea)
 {
-    std::lock_guard<std::mutex> lockGuard(trackingAreaMutex);
-    this->trackingArea = trackingArea;
+    cv::Rect2d sensorArea;
+    {
+        std::lock_guard<std::mutex> lockGuard(trackingAreaMutex);
+        this->trackingArea = trackingArea;
+        UpdateSensorTrackingArea();
+        sensorArea = sensorTrackingArea;
+    }
+
+    // The camera can skip reading out the sensor outside the tracking area
+    camera.UpdateSensorRegion(sensorArea);
+}
+
+void MarkerDetection::UpdateOrientation(OrientationData orientationData)
+{
+    cv::Rect2d sensorArea;
+    {
+        std::lock_guard<std::mutex> lockGuard(trackingAreaMutex);
+        this->orientationData = orientationData;
+        orientationTransform = GetOrientationTransform(orientationData);
+        UpdateSensorTrackingArea();
+        sensorArea = sensorTrackingArea;
+    }
+
+    camera.UpdateSensorRegion(sensorArea);
 }
 
 void MarkerDetection::UpdateDetectorParameters(DetectorParameterData detectorParameters)
 {
-    std::lock_guard<std::mutex> lockGuard(detectorParametersMutex);
-	this->detectorParameters = detectorParameters;
+    // The snapshot is published before its version so detection never sees a new version
+    // with old parameters
+    std::atomic_store(&this->detectorParameters,
+        std::make_shared<const DetectorParameterData>(detectorParameters));
+    detectorParametersVersion++;
+}
+
+void MarkerDetection::ToggleRoiTracking(bool isOn)
+{
+    isRoiTracking = isOn;
+}
+
+void MarkerDetection::UpdateFullScanInterval(int numFrames)
+{
+    fullScanInterval = std::max(numFrames, 1);
+}
+
+void MarkerDetection::UpdatePyramidLevel(int level)
+{
+    pyramidLevel = std::min(std::max(level, 0), kMaxPyramidLevel);
+}
+
+void MarkerDetection::UpdateTileMarkerSize(int pixels)
+{
+    tileMarkerSize = std::max(pixels, 0);
+}
+
+void MarkerDetection::UpdateDetectionWorkers(int numWorkers, int maxFramesInFlight)
+{
+    // Without a limit of its own the queue holds one frame per worker
+    numDetectionWorkers = std::max(numWorkers, 1);
+    maxJobsInFlight = (maxFramesInFlight > 0) ? maxFramesInFlight : std::max(numWorkers, 1);
+}
+
+int MarkerDetection::GetMinMarkerSize()
+{
+    return minMarkerSize;
+}
+
+void MarkerDetection::UpdateDetector()
+{
+    // A dictionary generated in the background is swapped in once it is ready
+    bool isDetectorChanged = false;
+    if (nextMarkerDictionary.valid() &&
+        nextMarkerDictionary.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        cv::Ptr<cv::aruco::Dictionary> dictionary = nextMarkerDictionary.get();
+        std::lock_guard<std::mutex> lockGuard(dictionaryMutex);
+        markerDictionary = dictionary;
+        isDetectorChanged = true;
+    }
+
+    // Checking the version is all the work done per frame while the parameters stay the same
+    unsigned int version = detectorParametersVersion;
+    if (version != appliedDetectorParametersVersion) {
+        appliedDetectorParametersVersion = version;
+        appliedDetectorParameters = std::atomic_load(&detectorParameters);
+
+        // Detectors that frames were already taken with keep the parameters they had
+        markerParameters = cv::makePtr<cv::aruco::DetectorParameters>(*markerParameters);
+        markerParameters->adaptiveThreshWinSizeMin = appliedDetectorParameters->adaptiveThreshWinSizeMin;
+        markerParameters->adaptiveThreshWinSizeMax = appliedDetectorParameters->adaptiveThreshWinSizeMax;
+        markerParameters->adaptiveThreshWinSizeStep = appliedDetectorParameters->adaptiveThreshWinSizeStep;
+        markerParameters->adaptiveThreshConstant = appliedDetectorParameters->adaptiveThreshConstant;
+
+        markerParameters->minMarkerPerimeterRate = appliedDetectorParameters->minMarkerPerimeterRate;
+        markerParameters->maxMarkerPerimeterRate = appliedDetectorParameters->maxMarkerPerimeterRate;
+        markerParameters->polygonalApproxAccuracyRate = appliedDetectorParameters->polygonalApproxAccuracyRate;
+        markerParameters->minCornerDistanceRate = appliedDetectorParameters->minCornerDistanceRate;
+        markerParameters->minMarkerDistanceRate = appliedDetectorParameters->minMarkerDistanceRate;
+        markerParameters->minDistanceToBorder = appliedDetectorParameters->minDistanceToBorder;
+
+        markerParameters->markerBorderBits = appliedDetectorParameters->markerBorderBits;
+        markerParameters->minOtsuStdDev = appliedDetectorParameters->minOtsuStdDev;
+        markerParameters->perspectiveRemovePixelPerCell = appliedDetectorParameters->perspectiveRemovePixelPerCell;
+        markerParameters->perspectiveRemoveIgnoredMarginPerCell = appliedDetectorParameters->perspectiveRemoveIgnoredMarginPerCell;
+
+        markerParameters->maxErroneousBitsInBorderRate = appliedDetectorParameters->maxErroneousBitsInBorderRate;
+        markerParameters->errorCorrectionRate = appliedDetectorParameters->errorCorrectionRate;
+
+        isDetectorChanged = true;
+    }
+
+    // Generating a dictionary can take seconds, so detection keeps using the previous one until
+    // the new one is ready. Only one is generated at a time, and if the size changed again in the
+    // meantime the next one starts once it is done.
+    int dictionarySize = appliedDetectorParameters->markerDictionarySize;
+    int numBits = appliedDetectorParameters->markerNumBits;
+    if (!nextMarkerDictionary.valid() &&
+        (markerDictionary->bytesList.rows != dictionarySize || markerDictionary->markerSize != numBits))
+    {
+        nextMarkerDictionary = std::async(std::launch::async, [dictionarySize, numBits]() {
+            return cv::aruco::generateCustomDictionary(dictionarySize, numBits);
+        });
+    }
+
+    if (isDetectorChanged) {
+        arucoDetector = cv::aruco::ArucoDetector(markerDictionary, markerParameters, refineParameters);
+    }
+}
+
+void MarkerDetection::UpdateDictionary()
+{
+    // Waits for the dictionary that the current parameters ask for, which is only worth doing
+    // before there are frames to detect
+    UpdateDetector();
+    if (nextMarkerDictionary.valid()) {
+        nextMarkerDictionary.wait();
+        UpdateDetector();
+    }
+}
+
+void MarkerDetection::UpdateSensorTrackingArea()
+{
+    // The tracking area is drawn on the table, so the part of the sensor image that covers it
+    // is the bounding box of its corners turned back to the orientation of the sensor
+    cv::Matx33d inverseTransform = orientationTransform.inv();
+    std::vector<cv::Point2d> corners = {
+        trackingArea.tl(),
+        cv::Point2d(trackingArea.x + trackingArea.width, trackingArea.y),
+        trackingArea.br(),
+        cv::Point2d(trackingArea.x, trackingArea.y + trackingArea.height)};
+
+    cv::Point2d minPoint(1, 1);
+    cv::Point2d maxPoint(0, 0);
+    for (int i = 0; i < corners.size(); i++) {
+        cv::Vec3d point = inverseTransform * cv::Vec3d(corners[i].x, corners[i].y, 1);
+        minPoint = cv::Point2d(std::min(minPoint.x, point[0]), std::min(minPoint.y, point[1]));
+        maxPoint = cv::Point2d(std::max(maxPoint.x, point[0]), std::max(maxPoint.y, point[1]));
+    }
+    sensorTrackingArea = cv::Rect2d(minPoint, maxPoint) & cv::Rect2d(0, 0, 1, 1);
+}
+
+cv::Matx33d MarkerDetection::GetOrientationTransform(const OrientationData& orientationData)
+{
+    // Maps normalized sensor coordinates to normalized table coordinates. Each step is in
+    // normalized coordinates, so a quarter turn doesn't depend on the shape of the image.
+    cv::Matx33d transform = cv::Matx33d::eye();
+    switch (orientationData.rotation) {
+    case OrientationRotation::Rotate90:
+        transform = cv::Matx33d(0, -1, 1, 1, 0, 0, 0, 0, 1);
+        break;
+    case OrientationRotation::Rotate180:
+        transform = cv::Matx33d(-1, 0, 1, 0, -1, 1, 0, 0, 1);
+        break;
+    case OrientationRotation::Rotate270:
+        transform = cv::Matx33d(0, 1, 0, -1, 0, 1, 0, 0, 1);
+        break;
+    default:
+        break;
+    }
+
+    if (orientationData.isMirrored) {
+        transform = cv::Matx33d(-1, 0, 1, 0, 1, 0, 0, 0, 1) * transform;
+    }
+
+    const cv::Matx23d& affine = orientationData.affine;
+    cv::Matx33d affineTransform(
+        affine(0, 0), affine(0, 1), affine(0, 2),
+        affine(1, 0), affine(1, 1), affine(1, 2),
+        0, 0, 1);
+    return affineTransform * transform;
 }
 
 void MarkerDetection::DrawGuides(cv::Mat &image)
@@ -288,7 +860,7 @@ void MarkerDetection::DrawMarkers(cv::Mat &image)
 {
     std::lock_guard<std::mutex> lockGuard(trackingDataMutex);
     // Draw the markers that are being tracked
-    for (auto iter = trackingData.begin(); iter != trackingData.end(); iter++ ) {
+    for (auto iter = trackingData.markers.begin(); iter != trackingData.markers.end(); iter++ ) {
         MarkerData markerData = iter->second;
         cv::Scalar color = ScalarHSV2BGR((markerData.id * 7), 255, 255);
         cv::line(image,
@@ -30,9 +30,14 @@
 #include "Camera.h"
 #include "MarkerData.h"
 #include "DetectorParameterData.h"
+#include "OrientationData.h"
 #include "FrameRateTimer.h"
+#include "FrameStatistics.h"
 #include "ExecutionTimer.h"
 #include <QObject>
+#include <future>
+#include <deque>
+#include <condition_variable>
 
 class MarkerDetection : public QObject
 {
@@ -43,50 +48,142 @@ public:
 	~MarkerDetection();
     void Pause();
     void Run();
+    void UpdateDictionary();
     void CopyImageTo(cv::Mat& destinationImage);
     bool GenerateMarkerImages(int imageSize);
-    std::map<int, MarkerData> GetTrackingData();
+    TrackingData GetTrackingData();
+    bool GetIsDetected();
+    int GetMinMarkerSize();
     unsigned int GetFrameNumber();
     double GetFrameRate();
+    StageStatistics GetStatistics();
+    void ResetStatistics();
 
 public slots:
     void UpdateTrackingArea(cv::Rect2d trackingArea);
+    void UpdateOrientation(OrientationData orientationData);
     void UpdateDetectorParameters(DetectorParameterData detectorParameters);
+    void ToggleRoiTracking(bool isOn);
+    void UpdateFullScanInterval(int numFrames);
+    void UpdatePyramidLevel(int level);
+    void UpdateTileMarkerSize(int pixels);
+    void UpdateDetectionWorkers(int numWorkers, int maxFramesInFlight);
 
 private:
+    // One frame on its way through detection, with everything detection needs taken when
+    // the frame is, so frames can be detected at the same time on different threads
+    struct DetectionJob
+    {
+        std::shared_ptr<const FrameData> frame;
+        cv::Rect2d trackingAreaInPixels;
+        cv::Rect2d undistortedTrackingArea;
+        cv::Point2d trackingAreaOffset;
+        bool isUndistortPoints = false;
+        cv::Matx33d transform;
+        cv::Size outputSize;
+
+        cv::aruco::ArucoDetector detector;
+        std::shared_ptr<const DetectorParameterData> parameters;
+        bool isDictionaryReady = false;
+        int pyramidLevel = 0;
+        int tileMarkerSize = 0;
+
+        std::vector<std::vector<cv::Point2f>> markerCorners;
+        std::vector<int> markerIds;
+        bool isDone = false;
+    };
+
+    void UpdateDetector();
+    void TakeFrame(std::shared_ptr<const FrameData> frame, DetectionJob& job);
+    void DetectMarkers(DetectionJob& job, std::vector<std::vector<cv::Point2f>>& rejectedCandidates,
+        cv::Mat& pyramidImage, bool isNearbySearch);
+    void PublishFrame(const DetectionJob& job);
+    void StartWorkers(int numWorkers);
+    void RunWorker();
+    void PublishNextJob();
+    std::vector<cv::Rect> GetSearchWindows(cv::Size imageSize, cv::Point2d trackingAreaOffset);
+    static int CalculateMinMarkerSize(const DetectorParameterData& parameters, cv::Size imageSize, int pyramidLevel);
+    void UpdateSensorTrackingArea();
+    static cv::Matx33d GetOrientationTransform(const OrientationData& orientationData);
     void DrawGuides(cv::Mat &image);
     void DrawMarkers(cv::Mat &image);
     cv::Scalar ScalarHSV2BGR(uchar H, uchar S, uchar V);
 
     Camera & camera;
-	cv::Mat inputImage;
-    cv::Mat trackingImage;
-    cv::Mat outputImage;
+    std::shared_ptr<const FrameData> outputFrame;
 
     bool isDetected;
-    std::map<int, MarkerData> trackingData;
+    TrackingData trackingData;
 
     cv::Rect2d trackingArea;
-    cv::Rect2d trackingAreaInPixels;
+
+    // The tracking area is in the orientation of the table and the sensor tracking area
+    // is the part of the sensor image that covers it
+    OrientationData orientationData;
+    cv::Matx33d orientationTransform;
+    cv::Rect2d sensorTrackingArea;
 
     unsigned int currentFrameNumber;
     unsigned int lastFrameNumber;
+    unsigned int frameSequenceNumber;
+
+    // Parameters are published as snapshots that never change once published.
+    // Detection only reads a new snapshot when the version changes and rebuilds the detector then.
+    std::shared_ptr<const DetectorParameterData> detectorParameters;
+    std::atomic<unsigned int> detectorParametersVersion;
+    std::shared_ptr<const DetectorParameterData> appliedDetectorParameters;
+    unsigned int appliedDetectorParametersVersion;
 
-	DetectorParameterData detectorParameters;
+    // Only detection replaces the dictionary, and the lock is for the GUI reading it
 	cv::Ptr<cv::aruco::Dictionary> markerDictionary;
+    std::future<cv::Ptr<cv::aruco::Dictionary>> nextMarkerDictionary;
+    std::mutex dictionaryMutex;
 	cv::Ptr<cv::aruco::DetectorParameters> markerParameters;
 	cv::Ptr<cv::aruco::RefineParameters> refineParameters;
 
 	cv::aruco::ArucoDetector arucoDetector;
-	std::vector<std::vector<cv::Point2f>> markerCorners;
+    DetectionJob detectionJob;
 	std::vector<std::vector<cv::Point2f>> rejectedCandidates;
-	std::vector<int> markerIds;
+
+    // Markers found in the last frame, in full camera image pixels, which are searched for
+    // near where they were until the next scan of the whole tracking area
+    std::atomic<bool> isRoiTracking;
+    std::atomic<int> fullScanInterval;
+    std::vector<std::vector<cv::Point2f>> previousMarkerCorners;
+    std::vector<int> previousMarkerIds;
+    cv::Size previousFullSize;
+    int numFramesSinceFullScan;
+    std::vector<std::vector<cv::Point2f>> windowMarkerCorners;
+    std::vector<int> windowMarkerIds;
+
+    // Markers are searched for on the image downscaled by 2 to the power of the pyramid level.
+    // The smallest marker that can still be found is in camera image pixels.
+    std::atomic<int> pyramidLevel;
+    std::atomic<int> minMarkerSize;
+    cv::Mat pyramidImage;
+
+    // The whole tracking area is split into tiles searched at the same time when this is
+    // the size of the largest marker in pixels, and searched in one piece when it is 0
+    std::atomic<int> tileMarkerSize;
+
+    // With more than one worker, each worker takes the next frame from the camera and detects it
+    // while the others detect the frames before it. Run() publishes the results in frame order.
+    // The queue holds the frames taken but not yet published, which bounds the latency.
+    std::atomic<int> numDetectionWorkers;
+    std::atomic<int> maxJobsInFlight;
+    std::vector<std::thread> detectionWorkers;
+    std::deque<std::shared_ptr<DetectionJob>> jobs;
+    std::atomic<bool> isWorkerRunning;
+    bool isPublishing;
+    std::mutex jobsMutex;
+    std::mutex takeFrameMutex;
+    std::condition_variable jobCondition;
 
     std::mutex outputImageMutex;
     std::mutex trackingAreaMutex;
     std::mutex trackingDataMutex;
-    std::mutex detectorParametersMutex;
 
+    SequenceCounter frameCounter;
     FrameRateTimer frameRateTimer;
     ExecutionTimer executionTimer;
 };
@@ -0,0 +1,204 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "MarkerSearch.h"
+
+// Corners found on a downscaled image are refined on the full resolution image until they
+// move less than this many pixels
+static const int kCornerRefinementMaxIterations = 30;
+static const double kCornerRefinementMinAccuracy = 0.01;
+
+// Extra overlap between tiles in pixels, so a marker at the edge of the overlap is still
+// further from the tile border than the detector's minimum distance at every pyramid level
+static const int kTileMargin = 16;
+
+// The same marker found in two tiles has corners this close, as a fraction of its size
+static const double kDuplicateMarkerDistanceRate = 0.25;
+
+static double GetPerimeter(const std::vector<cv::Point2f>& corners)
+{
+    double perimeter = 0;
+    for (int i = 0; i < corners.size(); i++) {
+        perimeter += cv::norm(corners[(i + 1) % corners.size()] - corners[i]);
+    }
+    return perimeter;
+}
+
+static bool IsSameMarker(const std::vector<cv::Point2f>& corners, const std::vector<cv::Point2f>& otherCorners)
+{
+    if (corners.size() != otherCorners.size() || corners.empty()) {
+        return false;
+    }
+
+    double distance = 0;
+    for (int i = 0; i < corners.size(); i++) {
+        distance += cv::norm(corners[i] - otherCorners[i]);
+    }
+    distance /= corners.size();
+    double size = GetPerimeter(corners) / corners.size();
+    return distance < kDuplicateMarkerDistanceRate * size;
+}
+
+void DetectMarkersPyramid(cv::aruco::ArucoDetector& detector, const cv::Mat& image, int pyramidLevel,
+    std::vector<std::vector<cv::Point2f>>& corners, std::vector<int>& ids,
+    std::vector<std::vector<cv::Point2f>>& rejectedCandidates, cv::Mat& downscaledImage)
+{
+    int level = std::min(std::max(pyramidLevel, 0), kMaxPyramidLevel);
+    if (level == 0) {
+        detector.detectMarkers(image, corners, ids, rejectedCandidates);
+        return;
+    }
+
+    // Markers are found and decoded on a downscaled copy of the image, because that is where
+    // the adaptive thresholds and the contour search spend their time. Only the corners of the
+    // markers found are refined on the full resolution image, so they keep their precision.
+    float scale = float(1 << level);
+    cv::resize(image, downscaledImage, cv::Size(), 1.0 / scale, 1.0 / scale, cv::INTER_AREA);
+    detector.detectMarkers(downscaledImage, corners, ids, rejectedCandidates);
+
+    // The corners can be off by about one downscaled pixel, so the refinement window has to
+    // reach that far on the full resolution image
+    int halfWindowSize = (1 << level) + 1;
+    cv::TermCriteria criteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT,
+        kCornerRefinementMaxIterations, kCornerRefinementMinAccuracy);
+    cv::Rect imageArea(0, 0, image.cols, image.rows);
+    for (int i = 0; i < corners.size(); i++) {
+        // Each downscaled pixel center lies between the centers of the pixels it was made from
+        for (int j = 0; j < corners[i].size(); j++) {
+            corners[i][j].x = (corners[i][j].x + 0.5f) * scale - 0.5f;
+            corners[i][j].y = (corners[i][j].y + 0.5f) * scale - 0.5f;
+        }
+
+        cv::Rect refinementArea = cv::boundingRect(corners[i]);
+        int padding = 2 * halfWindowSize;
+        refinementArea = cv::Rect(refinementArea.x - padding, refinementArea.y - padding,
+            refinementArea.width + 2 * padding, refinementArea.height + 2 * padding) & imageArea;
+        if (refinementArea.empty()) {
+            continue;
+        }
+
+        cv::Mat refinementImage;
+        if (image.channels() == 1) {
+            refinementImage = image(refinementArea);
+        }
+        else {
+            cv::cvtColor(image(refinementArea), refinementImage, cv::COLOR_BGR2GRAY);
+        }
+
+        cv::Point2f areaOffset(refinementArea.x, refinementArea.y);
+        for (int j = 0; j < corners[i].size(); j++) {
+            corners[i][j] -= areaOffset;
+        }
+        cv::cornerSubPix(refinementImage, corners[i], cv::Size(halfWindowSize, halfWindowSize), cv::Size(-1, -1), criteria);
+        for (int j = 0; j < corners[i].size(); j++) {
+            corners[i][j] += areaOffset;
+        }
+    }
+}
+
+void DetectMarkersTiled(cv::aruco::ArucoDetector& detector, const cv::Mat& image, int pyramidLevel,
+    int maxMarkerSize, double minMarkerPerimeterRate,
+    std::vector<std::vector<cv::Point2f>>& corners, std::vector<int>& ids)
+{
+    std::vector<cv::Rect> tiles = GetDetectionTiles(image.size(), maxMarkerSize, cv::getNumThreads());
+    std::vector<std::vector<std::vector<cv::Point2f>>> tileCorners(tiles.size());
+    std::vector<std::vector<int>> tileIds(tiles.size());
+
+    // OpenCV runs the parallel loops inside the detector on the calling thread here,
+    // so each tile is searched by one thread from start to finish
+    cv::parallel_for_(cv::Range(0, (int)tiles.size()), [&](const cv::Range& range) {
+        cv::aruco::ArucoDetector tileDetector = detector;
+        std::vector<std::vector<cv::Point2f>> rejectedCandidates;
+        cv::Mat downscaledImage;
+        for (int i = range.start; i < range.end; i++) {
+            DetectMarkersPyramid(tileDetector, image(tiles[i]), pyramidLevel, tileCorners[i], tileIds[i],
+                rejectedCandidates, downscaledImage);
+
+            cv::Point2f tileOffset(tiles[i].x, tiles[i].y);
+            for (int j = 0; j < tileCorners[i].size(); j++) {
+                for (int k = 0; k < tileCorners[i][j].size(); k++) {
+                    tileCorners[i][j][k] += tileOffset;
+                }
+            }
+        }
+    }, (double)tiles.size());
+
+    // The minimum perimeter is relative to the size of the image searched, which is smaller
+    // for a tile, so it is checked again against the whole image
+    double minPerimeter = minMarkerPerimeterRate * std::max(image.cols, image.rows);
+    corners.clear();
+    ids.clear();
+    for (int i = 0; i < tiles.size(); i++) {
+        for (int j = 0; j < tileIds[i].size(); j++) {
+            if (GetPerimeter(tileCorners[i][j]) >= minPerimeter) {
+                corners.push_back(tileCorners[i][j]);
+                ids.push_back(tileIds[i][j]);
+            }
+        }
+    }
+    RemoveDuplicateMarkers(corners, ids);
+}
+
+std::vector<cv::Rect> GetDetectionTiles(cv::Size imageSize, int maxMarkerSize, int numTiles)
+{
+    // Tiles are laid out on a grid with about the same aspect ratio as the image. A marker that
+    // crosses the line between two tiles is whole in one of them when each tile reaches half the
+    // largest marker size past the line. Tiles are kept at least as large as the overlap, or
+    // searching the overlap twice would cost more than the extra threads save.
+    int overlap = std::max(maxMarkerSize, 0) / 2 + kTileMargin;
+    int numColumns = std::max((int)std::round(std::sqrt(std::max(numTiles, 1) * (double)imageSize.width / imageSize.height)), 1);
+    int numRows = std::max((std::max(numTiles, 1) + numColumns - 1) / numColumns, 1);
+    numColumns = std::min(numColumns, std::max(imageSize.width / (2 * overlap), 1));
+    numRows = std::min(numRows, std::max(imageSize.height / (2 * overlap), 1));
+
+    cv::Rect imageArea(cv::Point(0, 0), imageSize);
+    std::vector<cv::Rect> tiles;
+    for (int row = 0; row < numRows; row++) {
+        for (int column = 0; column < numColumns; column++) {
+            cv::Point topLeft(column * imageSize.width / numColumns - overlap,
+                row * imageSize.height / numRows - overlap);
+            cv::Point bottomRight((column + 1) * imageSize.width / numColumns + overlap,
+                (row + 1) * imageSize.height / numRows + overlap);
+            tiles.push_back(cv::Rect(topLeft, bottomRight) & imageArea);
+        }
+    }
+    return tiles;
+}
+
+void RemoveDuplicateMarkers(std::vector<std::vector<cv::Point2f>>& corners, std::vector<int>& ids)
+{
+    // Markers with the same ID further apart are separate prints of the same marker,
+    // which a search of the whole image reports separately too
+    for (int i = 0; i < ids.size(); i++) {
+        for (int j = (int)ids.size() - 1; j > i; j--) {
+            if (ids[j] == ids[i] && IsSameMarker(corners[i], corners[j])) {
+                corners.erase(corners.begin() + j);
+                ids.erase(ids.begin() + j);
+            }
+        }
+    }
+}
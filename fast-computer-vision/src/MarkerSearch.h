@@ -0,0 +1,50 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+
+// Markers can be searched for on the image downscaled by up to 4 times, which is pyramid level 2
+const int kMaxPyramidLevel = 2;
+
+// Finds markers on the image downscaled by 2 to the power of the pyramid level and refines
+// their corners on the full resolution image. Level 0 searches the image as it is.
+// The downscaled image is kept by the caller so it can be reused from frame to frame.
+void DetectMarkersPyramid(cv::aruco::ArucoDetector& detector, const cv::Mat& image, int pyramidLevel,
+    std::vector<std::vector<cv::Point2f>>& corners, std::vector<int>& ids,
+    std::vector<std::vector<cv::Point2f>>& rejectedCandidates, cv::Mat& downscaledImage);
+
+// Splits the image into overlapping tiles, about one per thread, and searches them at the same
+// time. Tiles overlap enough that every marker up to the largest marker size, in pixels, is whole
+// in at least one of them. Markers found in two tiles are only reported once, and markers smaller
+// than the minimum perimeter rate of the whole image are dropped, like a search of the whole image.
+void DetectMarkersTiled(cv::aruco::ArucoDetector& detector, const cv::Mat& image, int pyramidLevel,
+    int maxMarkerSize, double minMarkerPerimeterRate,
+    std::vector<std::vector<cv::Point2f>>& corners, std::vector<int>& ids);
+
+std::vector<cv::Rect> GetDetectionTiles(cv::Size imageSize, int maxMarkerSize, int numTiles);
+void RemoveDuplicateMarkers(std::vector<std::vector<cv::Point2f>>& corners, std::vector<int>& ids);
@@ -27,10 +27,9 @@
 
 #include "NetworkCommunication.h"
 
-NetworkCommunication::NetworkCommunication(MarkerDetection& markerDetection) :
-    markerDetection(markerDetection),
-    currentFrameNumber(0),
-    lastFrameNumber(0)
+NetworkCommunication::NetworkCommunication(TrackingMerger& trackingMerger) :
+    trackingMerger(trackingMerger),
+    cameraHealth(CameraHealth::Disconnected)
 {
 }
 
@@ -41,29 +40,49 @@ NetworkCommunication::~NetworkCommunication()
 void NetworkCommunication::Pause()
 {
     frameRateTimer.Reset();
+    frameCounter.Restart();
 }
 
 void NetworkCommunication::Run()
 {
-    currentFrameNumber = markerDetection.GetFrameNumber();
-    if (lastFrameNumber == currentFrameNumber) {
+    // Only send when a camera has detected a new frame
+    if (!trackingMerger.Update()) {
         return;
     }
 
     executionTimer.Start();
 
-    trackingData.clear();
-    trackingData = markerDetection.GetTrackingData();
+    trackingData = trackingMerger.GetTrackingData();
+    if (Send(trackingData)) {
+        frameCounter.Count(trackingData.sequenceNumber);
+    }
+
+    frameRateTimer.Update();
+    executionTimer.Stop();
+    //std::cout << "Network communication: " << executionTimer.duration << " ms" << std::endl;
+}
+
+void NetworkCommunication::SendStatus()
+{
+    // While no camera sends images a packet with no markers still goes out, so clients can tell
+    // that tracking stopped from the camera health instead of holding on to the last markers
+    TrackingData statusData;
+    statusData.frameNumber = trackingData.frameNumber;
+    statusData.captureTime = std::chrono::system_clock::now();
+    Send(statusData);
+}
 
+bool NetworkCommunication::Send(const TrackingData& trackingData)
+{
     try {
         QByteArray byteArray;
 
-        byteArray.append(QByteArray::fromRawData(reinterpret_cast<const char *>(&currentFrameNumber), sizeof(unsigned int)));
+        byteArray.append(QByteArray::fromRawData(reinterpret_cast<const char *>(&trackingData.frameNumber), sizeof(unsigned int)));
 
-        unsigned int numMarkers = trackingData.size();
+        unsigned int numMarkers = trackingData.markers.size();
         byteArray.append(QByteArray::fromRawData(reinterpret_cast<const char *>(&numMarkers), sizeof(unsigned int)));
 
-        for (auto iter = trackingData.begin(); iter != trackingData.end(); iter++ ) {
+        for (auto iter = trackingData.markers.begin(); iter != trackingData.markers.end(); iter++ ) {
             MarkerData markerData = iter->second;
             byteArray.append(QByteArray::fromRawData(reinterpret_cast<const char *>(&markerData.id), sizeof(int)));
             byteArray.append(QByteArray::fromRawData(reinterpret_cast<const char *>(&markerData.center[0]), sizeof(float)));
@@ -77,16 +96,28 @@ void NetworkCommunication::Run()
         {
             // Prevent changes to the UDP parameters when sending data
             std::lock_guard<std::mutex> lockGuard(udpParametersMutex);
+
+            // Timing goes after the markers so clients that don't use it can ignore it.
+            // The capture time lets clients extrapolate marker positions to when they are displayed,
+            // and the latency is measured here so it doesn't depend on the clocks being in sync.
+            long long captureTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                trackingData.captureTime.time_since_epoch()).count();
+            unsigned int latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now() - trackingData.captureTime).count();
+            byteArray.append(QByteArray::fromRawData(reinterpret_cast<const char *>(&captureTime), sizeof(long long)));
+            byteArray.append(QByteArray::fromRawData(reinterpret_cast<const char *>(&latency), sizeof(unsigned int)));
+
+            unsigned int health = (unsigned int)cameraHealth.load();
+            byteArray.append(QByteArray::fromRawData(reinterpret_cast<const char *>(&health), sizeof(unsigned int)));
+
             socket.writeDatagram(byteArray, address, port);
         }
-
-        lastFrameNumber = currentFrameNumber;
     }
-    catch(...) {}
+    catch(...) {
+        return false;
+    }
 
-    frameRateTimer.Update();
-    executionTimer.Stop();
-    //std::cout << "Network communication: " << executionTimer.duration << " ms" << std::endl;
+    return true;
 }
 
 void NetworkCommunication::UpdateUdpParameters(QHostAddress address, uint port)
@@ -96,7 +127,22 @@ void NetworkCommunication::UpdateUdpParameters(QHostAddress address, uint port)
     this->port = port;
 }
 
+void NetworkCommunication::UpdateCameraHealth(CameraHealth cameraHealth)
+{
+    this->cameraHealth = cameraHealth;
+}
+
 double NetworkCommunication::GetFrameRate()
 {
     return frameRateTimer.frameRate;
 }
+
+StageStatistics NetworkCommunication::GetStatistics()
+{
+    return frameCounter.GetStatistics();
+}
+
+void NetworkCommunication::ResetStatistics()
+{
+    frameCounter.Reset();
+}
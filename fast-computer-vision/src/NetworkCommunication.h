@@ -27,32 +27,38 @@
 
 #pragma once
 #include "pch.h"
-#include "MarkerDetection.h"
+#include "TrackingMerger.h"
 #include "FrameRateTimer.h"
 #include "ExecutionTimer.h"
+#include "FrameStatistics.h"
 #include <QUdpSocket>
 
 class NetworkCommunication
 {
 public:
-    NetworkCommunication(MarkerDetection& markerDetection);
+    NetworkCommunication(TrackingMerger& trackingMerger);
     ~NetworkCommunication();
     void Pause();
     void Run();
+    void SendStatus();
     void UpdateUdpParameters(QHostAddress address, uint port);
+    void UpdateCameraHealth(CameraHealth cameraHealth);
     double GetFrameRate();
+    StageStatistics GetStatistics();
+    void ResetStatistics();
 
 private:
-    MarkerDetection & markerDetection;
-    std::map<int, MarkerData> trackingData;
+    bool Send(const TrackingData& trackingData);
 
-    unsigned int currentFrameNumber;
-    unsigned int lastFrameNumber;
+    TrackingMerger & trackingMerger;
+    TrackingData trackingData;
+    std::atomic<CameraHealth> cameraHealth;
 
     QHostAddress address;
     uint port;
 
     std::mutex udpParametersMutex;
+    SequenceCounter frameCounter;
     FrameRateTimer frameRateTimer;
     ExecutionTimer executionTimer;
 };
@@ -0,0 +1,43 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+
+// Clockwise rotation from the sensor to the table
+enum class OrientationRotation {Rotate0, Rotate90, Rotate180, Rotate270};
+
+// How the camera is mounted relative to the table. The image stays in the orientation
+// of the sensor and only marker coordinates are turned to the orientation of the table.
+struct OrientationData
+{
+    OrientationRotation rotation = OrientationRotation::Rotate0;
+    bool isMirrored = false;
+
+    // Applied last, in normalized table coordinates
+    cv::Matx23d affine = cv::Matx23d(1, 0, 0, 0, 1, 0);
+};
@@ -0,0 +1,180 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "RecordingFrameSource.h"
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+RecordingFrameSource::RecordingFrameSource(std::string path, FramePacing pacing, double frameRate) :
+    SoftwareFrameSource(pacing, frameRate),
+    path(path),
+    fileData(nullptr),
+    index(nullptr),
+    numFrames(0),
+    frameIndex(0),
+    imageType(0)
+{
+}
+
+bool RecordingFrameSource::Open()
+{
+    Close();
+
+    file.setFileName(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cout << "Open() Error: Unable to open recording " << path << std::endl;
+        return false;
+    }
+    qint64 fileSize = file.size();
+    fileData = (fileSize >= (qint64)sizeof(RecordingHeader)) ? file.map(0, fileSize) : nullptr;
+    if (fileData == nullptr) {
+        std::cout << "Open() Error: Unable to read recording " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    RecordingHeader header;
+    std::memcpy(&header, fileData, sizeof(header));
+    if (std::memcmp(header.magic, kRecordingMagic, sizeof(header.magic)) != 0 || header.version != kRecordingVersion) {
+        std::cout << "Open() Error: " << path << " is not a flight recording" << std::endl;
+        Close();
+        return false;
+    }
+    if (header.numFrames == 0 || header.indexOffset % alignof(RecordingIndexEntry) != 0 ||
+        header.indexOffset + (uint64_t)header.numFrames * sizeof(RecordingIndexEntry) > (uint64_t)fileSize ||
+        header.reasonOffset + header.reasonLength > (uint64_t)fileSize)
+    {
+        std::cout << "Open() Error: Recording " << path << " is incomplete" << std::endl;
+        Close();
+        return false;
+    }
+
+    // Every image is checked against the first one when it is read
+    index = (const RecordingIndexEntry*)(fileData + header.indexOffset);
+    numFrames = header.numFrames;
+    frameIndex = 0;
+    imageSize = cv::Size(index[0].fullWidth, index[0].fullHeight);
+    imageType = index[0].imageType;
+
+#ifndef USE_LZ4
+    for (uint32_t i = 0; i < numFrames; i++) {
+        if (index[i].compression != (uint32_t)RecordingCompression::None) {
+            std::cout << "Open() Error: Built without LZ4, unable to play back compressed recording " << path << std::endl;
+            Close();
+            return false;
+        }
+    }
+#endif
+
+    // Play back at the rate the images were recorded at
+    double recordedSeconds = (index[numFrames - 1].captureTimeUs - index[0].captureTimeUs) / 1e6;
+    if (numFrames > 1 && recordedSeconds > 0) {
+        frameRate = (numFrames - 1) / recordedSeconds;
+    }
+
+    std::string reason((const char*)fileData + header.reasonOffset, header.reasonLength);
+    std::cout << "Flight Recording: " << path << ", " << numFrames << " images, "
+        << imageSize.width << " x " << imageSize.height << " at " << frameRate << " fps" << std::endl;
+    std::cout << reason << std::endl;
+    ResetPacing();
+    return true;
+}
+
+void RecordingFrameSource::Close()
+{
+    if (fileData != nullptr) {
+        file.unmap((uchar*)fileData);
+    }
+    file.close();
+    fileData = nullptr;
+    index = nullptr;
+    numFrames = 0;
+    regionImage.release();
+    recordingImage.release();
+}
+
+bool RecordingFrameSource::IsOpen()
+{
+    return numFrames > 0;
+}
+
+cv::Size RecordingFrameSource::GetImageSize()
+{
+    return imageSize;
+}
+
+bool RecordingFrameSource::ReadImage(SourceImage& sourceImage)
+{
+    const RecordingIndexEntry& entry = index[frameIndex];
+    frameIndex = (frameIndex + 1) % numFrames;
+
+    cv::Rect region(entry.regionX, entry.regionY, entry.regionWidth, entry.regionHeight);
+    if (entry.fullWidth != imageSize.width || entry.fullHeight != imageSize.height || entry.imageType != imageType ||
+        region.empty() || (region & cv::Rect(cv::Point(), imageSize)) != region ||
+        entry.dataOffset + entry.dataSize > (uint64_t)file.size())
+    {
+        std::cout << "ReadImage() Error: Skipping image " << entry.frameNumber << std::endl;
+        return false;
+    }
+
+    // The rest of the sensor is black, like it was never read out. A full sensor image
+    // is decoded straight into the image that is handed out.
+    recordingImage.create(imageSize, imageType);
+    cv::Mat decodedImage = recordingImage;
+    if (region.size() != imageSize) {
+        recordingImage.setTo(cv::Scalar::all(0));
+        regionImage.create(region.size(), imageType);
+        decodedImage = regionImage;
+    }
+
+    const char* data = (const char*)fileData + entry.dataOffset;
+    size_t numImageBytes = decodedImage.total() * decodedImage.elemSize();
+    bool isDecoded = false;
+    if (entry.compression == (uint32_t)RecordingCompression::None && entry.dataSize == numImageBytes) {
+        std::memcpy(decodedImage.data, data, numImageBytes);
+        isDecoded = true;
+    }
+#ifdef USE_LZ4
+    else if (entry.compression == (uint32_t)RecordingCompression::LZ4) {
+        int numDecodedBytes = LZ4_decompress_safe(data, (char*)decodedImage.data, (int)entry.dataSize, (int)numImageBytes);
+        isDecoded = (numDecodedBytes == (int)numImageBytes);
+    }
+#endif
+    if (!isDecoded) {
+        std::cout << "ReadImage() Error: Unable to decode image " << entry.frameNumber << std::endl;
+        return false;
+    }
+
+    if (decodedImage.data != recordingImage.data) {
+        decodedImage.copyTo(recordingImage(region));
+    }
+
+    sourceImage.image = recordingImage;
+    sourceImage.rawPixelFormat = (recordingImage.channels() == 1) ? RawPixelFormat::Mono8 : RawPixelFormat::Unknown;
+    return true;
+}
@@ -39,6 +39,9 @@ bool Settings::Load()
 
     file.open(QIODevice::ReadOnly);
 
+    // Repeated elements are added to lists, so start from empty lists
+    additionalCameras.clear();
+
     QXmlStreamReader xmlReader(&file);
     QString elementName;
     QString elementText;
@@ -99,6 +102,9 @@ void Settings::Save()
 
     xmlWriter.writeTextElement("gamma", QString::number(gamma));
     xmlWriter.writeTextElement("rotate", QString::number(rotate));
+    xmlWriter.writeTextElement("orientationRotation", QString::number(orientationRotation));
+    xmlWriter.writeTextElement("orientationMirror", QString::number(orientationMirror));
+    xmlWriter.writeTextElement("orientationAffine", orientationAffine);
 
     xmlWriter.writeTextElement("trackingAreaX", QString::number(trackingAreaX));
     xmlWriter.writeTextElement("trackingAreaY", QString::number(trackingAreaY));
@@ -135,6 +141,43 @@ void Settings::Save()
     xmlWriter.writeTextElement("maxErroneousBitsInBorderRate", QString::number(maxErroneousBitsInBorderRate));
     xmlWriter.writeTextElement("errorCorrectionRate", QString::number(errorCorrectionRate));
 
+    xmlWriter.writeComment("Performance settings");
+
+    xmlWriter.writeTextElement("grayscale", QString::number(grayscale));
+    xmlWriter.writeTextElement("useSensorRegion", QString::number(useSensorRegion));
+    xmlWriter.writeTextElement("readoutMode", QString::number(readoutMode));
+    xmlWriter.writeTextElement("pointUndistortion", QString::number(pointUndistortion));
+    xmlWriter.writeTextElement("flightRecorderSeconds", QString::number(flightRecorderSeconds));
+    xmlWriter.writeTextElement("flightRecorderAutoDump", QString::number(flightRecorderAutoDump));
+    xmlWriter.writeTextElement("flightRecorderMemory", QString::number(flightRecorderMemory));
+    xmlWriter.writeTextElement("stallTimeout", QString::number(stallTimeout));
+    xmlWriter.writeTextElement("autoExposure", QString::number(autoExposure));
+    xmlWriter.writeTextElement("autoExposureMaxTime", QString::number(autoExposureMaxTime));
+    xmlWriter.writeTextElement("autoExposureMaxGain", QString::number(autoExposureMaxGain));
+    xmlWriter.writeTextElement("autoExposureContrast", QString::number(autoExposureContrast));
+    xmlWriter.writeTextElement("roiTracking", QString::number(roiTracking));
+    xmlWriter.writeTextElement("fullScanInterval", QString::number(fullScanInterval));
+    xmlWriter.writeTextElement("pyramidLevel", QString::number(pyramidLevel));
+    xmlWriter.writeTextElement("tileMarkerSize", QString::number(tileMarkerSize));
+    xmlWriter.writeTextElement("detectionWorkers", QString::number(detectionWorkers));
+    xmlWriter.writeTextElement("detectionQueueDepth", QString::number(detectionQueueDepth));
+
+    xmlWriter.writeComment("Frame source settings");
+
+    xmlWriter.writeTextElement("frameSource", QString::number(frameSource));
+    xmlWriter.writeTextElement("frameSourcePath", frameSourcePath);
+    xmlWriter.writeTextElement("framePacing", QString::number(framePacing));
+    xmlWriter.writeTextElement("frameSourceFrameRate", QString::number(frameSourceFrameRate));
+    xmlWriter.writeTextElement("syntheticBayer", QString::number(syntheticBayer));
+
+    xmlWriter.writeComment("Multi-camera settings");
+
+    xmlWriter.writeTextElement("cameraSerialNumber", cameraSerialNumber);
+    xmlWriter.writeTextElement("cameraHomography", cameraHomography);
+    for (int i = 0; i < additionalCameras.size(); i++) {
+        xmlWriter.writeTextElement("additionalCamera", additionalCameras[i]);
+    }
+
     xmlWriter.writeEndElement(); // ApplicationSettings
 
     xmlWriter.writeEndDocument();
@@ -167,6 +210,15 @@ void Settings::Parse(QString name, QString text)
     else if (name == "rotate") {
         rotate = text.toInt();
     }
+    else if (name == "orientationRotation") {
+        orientationRotation = text.toInt();
+    }
+    else if (name == "orientationMirror") {
+        orientationMirror = text.toInt();
+    }
+    else if (name == "orientationAffine") {
+        orientationAffine = text;
+    }
 
     else if (name == "trackingAreaX") {
         trackingAreaX = text.toDouble();
@@ -252,5 +304,86 @@ void Settings::Parse(QString name, QString text)
     else if (name == "errorCorrectionRate") {
         errorCorrectionRate = text.toDouble();
     }
+
+    else if (name == "grayscale") {
+        grayscale = text.toInt();
+    }
+    else if (name == "useSensorRegion") {
+        useSensorRegion = text.toInt();
+    }
+    else if (name == "readoutMode") {
+        readoutMode = text.toInt();
+    }
+    else if (name == "pointUndistortion") {
+        pointUndistortion = text.toInt();
+    }
+    else if (name == "flightRecorderSeconds") {
+        flightRecorderSeconds = text.toDouble();
+    }
+    else if (name == "flightRecorderAutoDump") {
+        flightRecorderAutoDump = text.toInt();
+    }
+    else if (name == "flightRecorderMemory") {
+        flightRecorderMemory = text.toInt();
+    }
+    else if (name == "stallTimeout") {
+        stallTimeout = text.toDouble();
+    }
+    else if (name == "autoExposure") {
+        autoExposure = text.toInt();
+    }
+    else if (name == "autoExposureMaxTime") {
+        autoExposureMaxTime = text.toDouble();
+    }
+    else if (name == "autoExposureMaxGain") {
+        autoExposureMaxGain = text.toDouble();
+    }
+    else if (name == "autoExposureContrast") {
+        autoExposureContrast = text.toDouble();
+    }
+    else if (name == "roiTracking") {
+        roiTracking = text.toInt();
+    }
+    else if (name == "fullScanInterval") {
+        fullScanInterval = text.toInt();
+    }
+    else if (name == "pyramidLevel") {
+        pyramidLevel = text.toInt();
+    }
+    else if (name == "tileMarkerSize") {
+        tileMarkerSize = text.toInt();
+    }
+    else if (name == "detectionWorkers") {
+        detectionWorkers = text.toInt();
+    }
+    else if (name == "detectionQueueDepth") {
+        detectionQueueDepth = text.toInt();
+    }
+
+    else if (name == "frameSource") {
+        frameSource = text.toInt();
+    }
+    else if (name == "frameSourcePath") {
+        frameSourcePath = text;
+    }
+    else if (name == "framePacing") {
+        framePacing = text.toInt();
+    }
+    else if (name == "frameSourceFrameRate") {
+        frameSourceFrameRate = text.toDouble();
+    }
+    else if (name == "syntheticBayer") {
+        syntheticBayer = text.toInt();
+    }
+
+    else if (name == "cameraSerialNumber") {
+        cameraSerialNumber = text;
+    }
+    else if (name == "cameraHomography") {
+        cameraHomography = text;
+    }
+    else if (name == "additionalCamera") {
+        additionalCameras.append(text);
+    }
 }
 
@@ -33,6 +33,7 @@
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 #include <QDateTime>
+#include <QStringList>
 
 class Settings : public QObject
 {
@@ -52,6 +53,9 @@ public:
 
     double gamma = 0.5;
     bool rotate = false;
+    int orientationRotation = 0;
+    bool orientationMirror = false;
+    QString orientationAffine = "1 0 0 0 1 0";
 
     double trackingAreaX = 0;
     double trackingAreaY = 0;
@@ -86,6 +90,35 @@ public:
     double maxErroneousBitsInBorderRate = 0.35;
     double errorCorrectionRate = 0.6;
 
+    bool grayscale = false;
+    bool useSensorRegion = false;
+    int readoutMode = 0;
+    bool pointUndistortion = false;
+    double flightRecorderSeconds = 0;
+    bool flightRecorderAutoDump = true;
+    int flightRecorderMemory = 1024;
+    double stallTimeout = 2;
+    bool autoExposure = false;
+    double autoExposureMaxTime = 10000;
+    double autoExposureMaxGain = 12;
+    double autoExposureContrast = 80;
+    bool roiTracking = false;
+    int fullScanInterval = 10;
+    int pyramidLevel = 0;
+    int tileMarkerSize = 0;
+    int detectionWorkers = 1;
+    int detectionQueueDepth = 0;
+
+    int frameSource = 0;
+    QString frameSourcePath = "";
+    int framePacing = 0;
+    double frameSourceFrameRate = 30;
+    bool syntheticBayer = false;
+
+    QString cameraSerialNumber = "";
+    QString cameraHomography = "1 0 0 0 1 0 0 0 1";
+    QStringList additionalCameras;
+
 signals:
     void Error(QString text, QString informativeText);
     void RequestSave();
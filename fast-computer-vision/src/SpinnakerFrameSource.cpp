@@ -0,0 +1,459 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "SpinnakerFrameSource.h"
+
+// Grabbing gives up after this long so the camera's watchdog can notice a stalled stream
+static const uint64_t kGrabTimeoutMs = 1000;
+
+// Whether a camera without a serial number of its own may use the device
+static bool IsUnclaimedSerialNumber(const std::string& deviceSerialNumber, const std::vector<std::string>& otherSerialNumbers)
+{
+    return std::find(otherSerialNumbers.begin(), otherSerialNumbers.end(), deviceSerialNumber) == otherSerialNumbers.end();
+}
+
+SpinnakerFrameSource::SpinnakerFrameSource(std::string serialNumber, std::vector<std::string> otherSerialNumbers) :
+    serialNumber(serialNumber),
+    otherSerialNumbers(otherSerialNumbers)
+{
+    // Retrieve singleton reference to system object
+    spinnakerSystem = Spinnaker::System::GetInstance();
+
+    // Print out current library version
+    const Spinnaker::LibraryVersion spinnakerLibraryVersion = spinnakerSystem->GetLibraryVersion();
+    std::cout << "Spinnaker library version: "
+        << spinnakerLibraryVersion.major << "."
+        << spinnakerLibraryVersion.minor << "."
+        << spinnakerLibraryVersion.type << "."
+        << spinnakerLibraryVersion.build << std::endl << std::endl;
+
+    pCamera = NULL;
+}
+
+SpinnakerFrameSource::~SpinnakerFrameSource()
+{
+    Close();
+    if (arrivalHandler != nullptr) {
+        try {
+            spinnakerSystem->UnregisterEventHandler(*arrivalHandler);
+        }
+        catch (Spinnaker::Exception& exception) {
+            std::cout << "~SpinnakerFrameSource() Error: " << exception.what() << std::endl;
+        }
+    }
+    spinnakerSystem->ReleaseInstance();
+}
+
+void SpinnakerFrameSource::SetDeviceArrivalCallback(std::function<void()> callback)
+{
+    try {
+        if (arrivalHandler != nullptr) {
+            spinnakerSystem->UnregisterEventHandler(*arrivalHandler);
+        }
+        arrivalHandler = std::make_unique<SpinnakerArrivalHandler>(serialNumber, otherSerialNumbers, callback);
+        spinnakerSystem->RegisterEventHandler(*arrivalHandler);
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "SetDeviceArrivalCallback() Error: " << exception.what() << std::endl;
+        arrivalHandler.reset();
+    }
+}
+
+SpinnakerArrivalHandler::SpinnakerArrivalHandler(std::string serialNumber, std::vector<std::string> otherSerialNumbers,
+    std::function<void()> callback) :
+    serialNumber(serialNumber),
+    otherSerialNumbers(otherSerialNumbers),
+    callback(callback)
+{
+}
+
+void SpinnakerArrivalHandler::OnDeviceArrival(uint64_t deviceSerialNumber)
+{
+    // Other cameras on a multi-camera table don't concern this one
+    std::string deviceSerial = std::to_string(deviceSerialNumber);
+    if (serialNumber.empty() ? IsUnclaimedSerialNumber(deviceSerial, otherSerialNumbers) : serialNumber == deviceSerial) {
+        callback();
+    }
+}
+
+bool SpinnakerFrameSource::Open()
+{
+    // Retrieve list of cameras from the system
+    cameraList = spinnakerSystem->GetCameras();
+    unsigned int numCameras = cameraList.GetSize();
+
+    // Fail if no cameras are detected
+    if (numCameras < 1) {
+        cameraList.Clear();
+        return false;
+    }
+
+    // Select the camera with the serial number, or the first camera that no other camera pipeline
+    // uses if there isn't one. Each camera of a multi-camera table has its own frame source.
+    if (serialNumber.empty()) {
+        pCamera = NULL;
+        for (unsigned int i = 0; i < numCameras && pCamera == NULL; i++) {
+            try {
+                Spinnaker::CameraPtr pListedCamera = cameraList.GetByIndex(i);
+                std::string listedSerialNumber = pListedCamera->TLDevice.DeviceSerialNumber.GetValue().c_str();
+                if (IsUnclaimedSerialNumber(listedSerialNumber, otherSerialNumbers)) {
+                    pCamera = pListedCamera;
+                }
+            }
+            catch (Spinnaker::Exception& exception) {
+                std::cout << "Open() Error: " << exception.what() << std::endl;
+            }
+        }
+        if (pCamera == NULL) {
+            std::cout << "Open() Error: Every camera is used by another camera pipeline" << std::endl;
+            cameraList.Clear();
+            return false;
+        }
+    }
+    else {
+        pCamera = cameraList.GetBySerial(serialNumber);
+        if (pCamera == NULL) {
+            std::cout << "Open() Error: No camera with serial number " << serialNumber << std::endl;
+            cameraList.Clear();
+            return false;
+        }
+    }
+
+    try {
+        // Retrieve TL device nodemap and print device information
+        Spinnaker::GenApi::INodeMap& nodeMapTLDevice = pCamera->GetTLDeviceNodeMap();
+        PrintDeviceInfo(nodeMapTLDevice);
+
+        // Initialize camera
+        pCamera->Init();
+
+        std::cout << std::endl << std::endl << "*** CAMERA CONFIGURATION ***" << std::endl << std::endl;
+
+        // Retrieve stream parameters device nodemap
+        Spinnaker::GenApi::INodeMap& streamNodeMap = pCamera->GetTLStreamNodeMap();
+        // Set buffer handling mode
+        Spinnaker::GenApi::CEnumerationPtr ptrHandlingMode = streamNodeMap.GetNode("StreamBufferHandlingMode");
+        Spinnaker::GenApi::CEnumEntryPtr ptrHandlingModeEntry = ptrHandlingMode->GetCurrentEntry();
+        ptrHandlingModeEntry = ptrHandlingMode->GetEntryByName("NewestOnly");
+        ptrHandlingMode->SetIntValue(ptrHandlingModeEntry->GetValue());
+        std::cout << "Buffer Handling Mode: " << ptrHandlingModeEntry->GetDisplayName() << std::endl;
+
+        // Set other camera parameters
+        pCamera->AcquisitionMode.SetValue(Spinnaker::AcquisitionMode_Continuous);
+        pCamera->AcquisitionFrameRateEnable.SetValue(false);
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "Open() Error: " << exception.what() << std::endl;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void SpinnakerFrameSource::Close()
+{
+    if (pCamera != NULL) {
+        try {
+            // Release image pointer
+            Release();
+
+            // End acquisition
+            if (pCamera->IsStreaming()) {
+                pCamera->EndAcquisition();
+            }
+
+            // Deinitialize camera
+            if (pCamera->IsInitialized()) {
+                pCamera->DeInit();
+            }
+        }
+        catch (Spinnaker::Exception& exception) {
+            std::cout << "Close() Error: " << exception.what() << std::endl;
+        }
+
+        pCamera = NULL;
+    }
+
+    try {
+        // Clear camera list before releasing system
+        cameraList.Clear();
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "Close() Error: " << exception.what() << std::endl;
+    }
+}
+
+bool SpinnakerFrameSource::IsOpen()
+{
+    try {
+        return pCamera != NULL && pCamera->IsInitialized();
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "IsOpen() Error: " << exception.what() << std::endl;
+        return false;
+    }
+}
+
+bool SpinnakerFrameSource::ConfigureReadoutMode(ReadoutMode readoutMode, SensorGeometry& sensorGeometry)
+{
+    // Binning and decimation change the maximum image size, so the region is reset
+    // to the full sensor and the new limits are read back from the camera.
+    int binning = (readoutMode == ReadoutMode::Binning2x2) ? 2 : 1;
+    int decimation = (readoutMode == ReadoutMode::Decimation2x2) ? 2 : 1;
+
+    try {
+        StopAcquisition();
+
+        pCamera->OffsetX.SetValue(0);
+        pCamera->OffsetY.SetValue(0);
+
+        if (Spinnaker::GenApi::IsWritable(pCamera->BinningVertical)) {
+            pCamera->BinningVertical.SetValue(binning);
+        }
+        else if (binning > 1) {
+            std::cout << "ConfigureReadoutMode() Binning is not available on this camera" << std::endl;
+        }
+        if (Spinnaker::GenApi::IsWritable(pCamera->BinningHorizontal)) {
+            pCamera->BinningHorizontal.SetValue(binning);
+        }
+        if (Spinnaker::GenApi::IsWritable(pCamera->DecimationVertical)) {
+            pCamera->DecimationVertical.SetValue(decimation);
+        }
+        else if (decimation > 1) {
+            std::cout << "ConfigureReadoutMode() Decimation is not available on this camera" << std::endl;
+        }
+        if (Spinnaker::GenApi::IsWritable(pCamera->DecimationHorizontal)) {
+            pCamera->DecimationHorizontal.SetValue(decimation);
+        }
+
+        // Read out the full sensor until a smaller region is requested
+        sensorGeometry.size = cv::Size(pCamera->WidthMax.GetValue(), pCamera->HeightMax.GetValue());
+        sensorGeometry.offsetIncrement = cv::Size(pCamera->OffsetX.GetInc(), pCamera->OffsetY.GetInc());
+        sensorGeometry.sizeIncrement = cv::Size(pCamera->Width.GetInc(), pCamera->Height.GetInc());
+        sensorGeometry.minimumSize = cv::Size(pCamera->Width.GetMin(), pCamera->Height.GetMin());
+        pCamera->Width.SetValue(sensorGeometry.size.width);
+        pCamera->Height.SetValue(sensorGeometry.size.height);
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "ConfigureReadoutMode() Error: " << exception.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool SpinnakerFrameSource::ConfigureSensorRegion(cv::Rect region)
+{
+    try {
+        StopAcquisition();
+
+        // Reset the offsets first so the new size always fits on the sensor
+        pCamera->OffsetX.SetValue(0);
+        pCamera->OffsetY.SetValue(0);
+        pCamera->Width.SetValue(region.width);
+        pCamera->Height.SetValue(region.height);
+        pCamera->OffsetX.SetValue(region.x);
+        pCamera->OffsetY.SetValue(region.y);
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "ConfigureSensorRegion() Error: " << exception.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool SpinnakerFrameSource::ConfigureGamma(double gamma)
+{
+    try {
+        pCamera->Gamma.SetValue(gamma);
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "ConfigureGamma() Error: " << exception.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool SpinnakerFrameSource::ConfigureExposure(CameraExposure& exposure)
+{
+    try {
+        if (pCamera->ExposureAuto.GetValue() != Spinnaker::ExposureAuto_Off) {
+            pCamera->ExposureAuto.SetValue(Spinnaker::ExposureAuto_Off);
+        }
+        if (pCamera->GainAuto.GetValue() != Spinnaker::GainAuto_Off) {
+            pCamera->GainAuto.SetValue(Spinnaker::GainAuto_Off);
+        }
+
+        pCamera->ExposureTime.SetValue(std::clamp(exposure.exposureTime,
+            pCamera->ExposureTime.GetMin(), pCamera->ExposureTime.GetMax()));
+        pCamera->Gain.SetValue(std::clamp(exposure.gain, pCamera->Gain.GetMin(), pCamera->Gain.GetMax()));
+
+        exposure.exposureTime = pCamera->ExposureTime.GetValue();
+        exposure.gain = pCamera->Gain.GetValue();
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "ConfigureExposure() Error: " << exception.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool SpinnakerFrameSource::Grab(SourceImage& sourceImage, bool isGrayscale)
+{
+    try {
+        // Begin acquiring images
+        // If acquisition can't start the camera is closed so it will be reconnected.
+        if (!pCamera->IsStreaming()) {
+            pCamera->BeginAcquisition();
+            std::cout << std::endl << std::endl << "*** CAMERA ACQUISITION ***" << std::endl << std::endl;
+            std::cout << "Acquiring images..." << std::endl;
+        }
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "Grab() Acquisition Error: " << exception.what() << std::endl;
+        Close();
+        return false;
+    }
+
+    try {
+        // Retrieve next received image
+        pImage = pCamera->GetNextImage(kGrabTimeoutMs);
+        if (pImage == NULL || pImage->IsIncomplete()) {
+            sourceImage.isIncomplete = (pImage != NULL);
+            Release();
+            return false;
+        }
+
+        // In grayscale mode the image is built straight from the raw Bayer or Mono8 buffer
+        // because detection only needs a single channel and a full color debayer is expensive.
+        RawPixelFormat rawPixelFormat = isGrayscale ? GetRawPixelFormat(pImage->GetPixelFormat()) : RawPixelFormat::Unknown;
+        if (rawPixelFormat != RawPixelFormat::Unknown) {
+            sourceImage.image = cv::Mat(
+                pImage->GetHeight(),
+                pImage->GetWidth(),
+                CV_8UC1, pImage->GetData(),
+                pImage->GetStride());
+        }
+        else {
+            pConvertedImage = pImage->Convert(Spinnaker::PixelFormat_BGR8, Spinnaker::HQ_LINEAR);
+            sourceImage.image = cv::Mat(
+                pConvertedImage->GetHeight() + pConvertedImage->GetYPadding(),
+                pConvertedImage->GetWidth() + pConvertedImage->GetXPadding(),
+                CV_8UC3, pConvertedImage->GetData(),
+                pConvertedImage->GetStride());
+        }
+        sourceImage.rawPixelFormat = rawPixelFormat;
+        sourceImage.timestamp = pImage->GetTimeStamp();
+        sourceImage.frameId = pImage->GetFrameID();
+    }
+    catch (Spinnaker::Exception& exception) {
+        if (exception.GetError() != Spinnaker::SPINNAKER_ERR_TIMEOUT) {
+            std::cout << "Grab() Image Error: " << exception.what() << std::endl;
+        }
+        Release();
+        return false;
+    }
+
+    return true;
+}
+
+void SpinnakerFrameSource::Release()
+{
+    try {
+        // Release image pointer
+        if (pImage != NULL && pImage->IsInUse()) {
+            pImage->Release();
+        }
+    }
+    catch (Spinnaker::Exception& exception) {
+        std::cout << "Release() Error: " << exception.what() << std::endl;
+    }
+    pImage = NULL;
+    pConvertedImage = NULL;
+}
+
+void SpinnakerFrameSource::StopAcquisition()
+{
+    // The camera can only be reconfigured while it isn't acquiring
+    if (pCamera->IsStreaming()) {
+        pCamera->EndAcquisition();
+    }
+}
+
+bool SpinnakerFrameSource::PrintDeviceInfo(Spinnaker::GenApi::INodeMap& nodeMap)
+{
+    bool result = true;
+
+    std::cout << std::endl << "*** DEVICE INFORMATION ***" << std::endl << std::endl;
+
+    try
+    {
+        Spinnaker::GenApi::FeatureList_t features;
+        Spinnaker::GenApi::CCategoryPtr category = nodeMap.GetNode("DeviceInformation");
+        if (IsAvailable(category) && IsReadable(category))
+        {
+            category->GetFeatures(features);
+
+            Spinnaker::GenApi::FeatureList_t::const_iterator it;
+            for (it = features.begin(); it != features.end(); ++it)
+            {
+                Spinnaker::GenApi::CNodePtr pfeatureNode = *it;
+                std::cout << pfeatureNode->GetName() << " : ";
+                Spinnaker::GenApi::CValuePtr pValue = (Spinnaker::GenApi::CValuePtr)pfeatureNode;
+                std::cout << (IsReadable(pValue) ? pValue->ToString().c_str() : "Node not readable");
+                std::cout << std::endl;
+            }
+        }
+        else
+        {
+            std::cout << "Device control information not available." << std::endl;
+        }
+    }
+    catch (Spinnaker::Exception& exception)
+    {
+        std::cout << "PrintDeviceInfo() Error: " << exception.what() << std::endl;
+        result = false;
+    }
+
+    return result;
+}
+
+RawPixelFormat SpinnakerFrameSource::GetRawPixelFormat(Spinnaker::PixelFormatEnums pixelFormat)
+{
+    switch (pixelFormat) {
+    case Spinnaker::PixelFormat_Mono8: return RawPixelFormat::Mono8;
+    case Spinnaker::PixelFormat_BayerRG8: return RawPixelFormat::BayerRG8;
+    case Spinnaker::PixelFormat_BayerGB8: return RawPixelFormat::BayerGB8;
+    case Spinnaker::PixelFormat_BayerGR8: return RawPixelFormat::BayerGR8;
+    case Spinnaker::PixelFormat_BayerBG8: return RawPixelFormat::BayerBG8;
+    default: return RawPixelFormat::Unknown;
+    }
+}
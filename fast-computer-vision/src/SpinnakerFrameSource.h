@@ -0,0 +1,81 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "FrameSource.h"
+
+// Lets the camera know as soon as a FLIR camera is plugged in
+class SpinnakerArrivalHandler : public Spinnaker::DeviceArrivalEventHandler
+{
+public:
+    SpinnakerArrivalHandler(std::string serialNumber, std::vector<std::string> otherSerialNumbers,
+        std::function<void()> callback);
+    void OnDeviceArrival(uint64_t deviceSerialNumber) override;
+
+private:
+    std::string serialNumber;
+    std::vector<std::string> otherSerialNumbers;
+    std::function<void()> callback;
+};
+
+// Acquires images from a FLIR camera found by the Spinnaker SDK, either the one with the
+// given serial number or the first one found that isn't one of the other serial numbers,
+// which belong to the cameras of other camera pipelines.
+// Acquisition starts on the first Grab() and is stopped whenever the camera is reconfigured.
+class SpinnakerFrameSource : public FrameSource
+{
+public:
+    SpinnakerFrameSource(std::string serialNumber, std::vector<std::string> otherSerialNumbers);
+    ~SpinnakerFrameSource();
+
+    bool Open() override;
+    void Close() override;
+    bool IsOpen() override;
+
+    bool ConfigureReadoutMode(ReadoutMode readoutMode, SensorGeometry& sensorGeometry) override;
+    bool ConfigureSensorRegion(cv::Rect region) override;
+    bool ConfigureGamma(double gamma) override;
+    bool ConfigureExposure(CameraExposure& exposure) override;
+    bool Grab(SourceImage& sourceImage, bool isGrayscale) override;
+    void Release() override;
+    void SetDeviceArrivalCallback(std::function<void()> callback) override;
+
+private:
+    void StopAcquisition();
+    bool PrintDeviceInfo(Spinnaker::GenApi::INodeMap& nodeMap);
+    RawPixelFormat GetRawPixelFormat(Spinnaker::PixelFormatEnums pixelFormat);
+
+    std::string serialNumber;
+    std::vector<std::string> otherSerialNumbers;
+    Spinnaker::SystemPtr spinnakerSystem;
+    Spinnaker::CameraList cameraList;
+    Spinnaker::CameraPtr pCamera;
+    Spinnaker::ImagePtr pImage;
+    Spinnaker::ImagePtr pConvertedImage;
+    std::unique_ptr<SpinnakerArrivalHandler> arrivalHandler;
+};
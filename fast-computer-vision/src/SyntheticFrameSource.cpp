@@ -0,0 +1,160 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "SyntheticFrameSource.h"
+#include "ImageConversion.h"
+
+// The scene is drawn as bright as it is at this exposure time, in microseconds, in full light
+static const double kReferenceExposureTime = 10000;
+static const double kNoiseLevel = 2;
+
+// Warm light, in BGR, for the Bayer scene
+static const cv::Scalar kLightColor(0.7, 1.0, 0.9);
+
+SyntheticFrameSource::SyntheticFrameSource(const FrameSourceData& frameSourceData) :
+    SoftwareFrameSource(frameSourceData.pacing, frameSourceData.frameRate),
+    imageSize(frameSourceData.imageSize),
+    markerDictionarySize(frameSourceData.markerDictionarySize),
+    markerNumBits(frameSourceData.markerNumBits),
+    isBayer(frameSourceData.isSyntheticBayer),
+    isOpen(false),
+    frameNumber(0),
+    cellSize(0),
+    motionRadius(0),
+    isExposureSimulated(false)
+{
+}
+
+bool SyntheticFrameSource::Open()
+{
+    markerCenters.clear();
+    markerImages.clear();
+    frameNumber = 0;
+
+    try {
+        // Lay the markers out on a grid with about the same aspect ratio as the image
+        int numColumns = std::ceil(std::sqrt(markerDictionarySize * (double)imageSize.width / imageSize.height));
+        int numRows = (markerDictionarySize + numColumns - 1) / numColumns;
+        cellSize = std::min((double)imageSize.width / numColumns, (double)imageSize.height / numRows);
+        motionRadius = cellSize * 0.1;
+
+        // Each marker sits on a white square so it has a quiet zone around its border
+        int markerSize = cellSize * 0.5;
+        int quietZoneSize = markerSize / 8;
+        cv::Ptr<cv::aruco::Dictionary> markerDictionary = cv::aruco::generateCustomDictionary(
+            markerDictionarySize, markerNumBits);
+        cv::Mat markerImage;
+        for (int i = 0; i < markerDictionarySize; i++) {
+            cv::aruco::drawMarker(markerDictionary, i, markerSize, markerImage, 1);
+            cv::Mat paddedImage;
+            cv::copyMakeBorder(markerImage, paddedImage, quietZoneSize, quietZoneSize, quietZoneSize, quietZoneSize,
+                cv::BORDER_CONSTANT, cv::Scalar(255));
+            markerImages.push_back(paddedImage);
+
+            cv::Point2d gridOffset((imageSize.width - numColumns * cellSize) / 2, (imageSize.height - numRows * cellSize) / 2);
+            markerCenters.push_back(gridOffset + cv::Point2d(((i % numColumns) + 0.5) * cellSize, ((i / numColumns) + 0.5) * cellSize));
+        }
+
+        backgroundImage = cv::Mat(imageSize, CV_8UC1, cv::Scalar(96));
+        noiseImage = cv::Mat(imageSize, CV_8UC1);
+        cv::randn(noiseImage, cv::Scalar(128), cv::Scalar(kNoiseLevel));
+    }
+    catch (cv::Exception& exception) {
+        std::cout << "Open() Error: " << exception.what() << std::endl;
+        return false;
+    }
+
+    std::cout << "Synthetic Scene: " << markerDictionarySize << " markers, "
+        << imageSize.width << " x " << imageSize.height << (isBayer ? ", Bayer RG" : "") << std::endl;
+    isOpen = true;
+    ResetPacing();
+    return true;
+}
+
+void SyntheticFrameSource::Close()
+{
+    isOpen = false;
+}
+
+bool SyntheticFrameSource::IsOpen()
+{
+    return isOpen;
+}
+
+bool SyntheticFrameSource::ConfigureExposure(CameraExposure& exposure)
+{
+    exposure.exposureTime = std::clamp(exposure.exposureTime, 10.0, 100000.0);
+    exposure.gain = std::clamp(exposure.gain, 0.0, 24.0);
+    this->exposure = exposure;
+    isExposureSimulated = true;
+    return true;
+}
+
+cv::Size SyntheticFrameSource::GetImageSize()
+{
+    return imageSize;
+}
+
+bool SyntheticFrameSource::ReadImage(SourceImage& sourceImage)
+{
+    // Each marker goes around its circle once every 4 seconds of nominal frame time
+    double seconds = frameNumber / std::max(frameRate, 1.0);
+    frameNumber++;
+
+    backgroundImage.copyTo(sceneImage);
+    for (size_t i = 0; i < markerImages.size(); i++) {
+        double angle = 2 * CV_PI * (seconds / 4.0 + (double)i / markerImages.size());
+        cv::Point2d center = markerCenters[i] + motionRadius * cv::Point2d(std::cos(angle), std::sin(angle));
+        cv::Rect markerArea(
+            cv::Point(center.x - markerImages[i].cols / 2, center.y - markerImages[i].rows / 2),
+            markerImages[i].size());
+        markerArea &= cv::Rect(cv::Point(0, 0), imageSize);
+        markerImages[i](cv::Rect(cv::Point(0, 0), markerArea.size())).copyTo(sceneImage(markerArea));
+    }
+
+    // The light dims to a fifth and comes back once a minute so the auto exposure has something
+    // to follow. Gain brightens the sensor noise along with the scene.
+    if (isExposureSimulated) {
+        double lighting = 0.6 + 0.4 * std::cos(2 * CV_PI * seconds / 60.0);
+        double gain = std::pow(10.0, exposure.gain / 20);
+        sceneImage.convertTo(sceneImage, -1, lighting * gain * exposure.exposureTime / kReferenceExposureTime);
+        cv::addWeighted(sceneImage, 1, noiseImage, gain, -128 * gain, sceneImage);
+    }
+
+    if (isBayer) {
+        cv::cvtColor(sceneImage, colorImage, cv::COLOR_GRAY2BGR);
+        cv::multiply(colorImage, kLightColor, colorImage);
+        GenerateSyntheticBayerImage(colorImage, RawPixelFormat::BayerRG8, bayerImage);
+        sourceImage.image = bayerImage;
+        sourceImage.rawPixelFormat = RawPixelFormat::BayerRG8;
+        return true;
+    }
+
+    sourceImage.image = sceneImage;
+    sourceImage.rawPixelFormat = RawPixelFormat::Mono8;
+    return true;
+}
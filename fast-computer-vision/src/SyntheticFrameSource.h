@@ -0,0 +1,73 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "FrameSource.h"
+
+// Generates a scene with every marker in the dictionary laid out on a grid, each one
+// moving in a small circle. Marker motion follows the frame number rather than the clock,
+// so the same frame always looks the same no matter how fast frames are generated.
+class SyntheticFrameSource : public SoftwareFrameSource
+{
+public:
+    SyntheticFrameSource(const FrameSourceData& frameSourceData);
+
+    bool Open() override;
+    void Close() override;
+    bool IsOpen() override;
+    bool ConfigureExposure(CameraExposure& exposure) override;
+
+protected:
+    cv::Size GetImageSize() override;
+    bool ReadImage(SourceImage& sourceImage) override;
+
+private:
+    cv::Size imageSize;
+    int markerDictionarySize;
+    int markerNumBits;
+    bool isBayer;
+
+    bool isOpen;
+    unsigned int frameNumber;
+    double cellSize;
+    double motionRadius;
+    std::vector<cv::Point2d> markerCenters;
+    std::vector<cv::Mat> markerImages;
+    cv::Mat backgroundImage;
+    cv::Mat sceneImage;
+
+    // Once the exposure is set the scene is lit like a sensor would see it
+    bool isExposureSimulated;
+    CameraExposure exposure;
+    cv::Mat noiseImage;
+
+    // The scene is tinted by the light before it is sampled through the color filter,
+    // so each color channel of the mosaic is different
+    cv::Mat colorImage;
+    cv::Mat bayerImage;
+};
@@ -0,0 +1,154 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "TrackingMerger.h"
+
+static cv::Point2f TransformPoint(const cv::Matx33d& homography, cv::Point2f point)
+{
+    cv::Vec3d transformedPoint = homography * cv::Vec3d(point.x, point.y, 1);
+    return cv::Point2f(transformedPoint[0] / transformedPoint[2], transformedPoint[1] / transformedPoint[2]);
+}
+
+TrackingMerger::TrackingMerger(MarkerDetection& markerDetection)
+{
+    CameraInput camera;
+    camera.markerDetection = &markerDetection;
+    camera.homography = cv::Matx33d::eye();
+    cameras.push_back(camera);
+}
+
+void TrackingMerger::AddCamera(MarkerDetection& markerDetection, cv::Matx33d homography)
+{
+    std::lock_guard<std::mutex> lockGuard(camerasMutex);
+    CameraInput camera;
+    camera.markerDetection = &markerDetection;
+    camera.homography = homography;
+    cameras.push_back(camera);
+}
+
+void TrackingMerger::UpdateCameraHomography(int cameraIndex, cv::Matx33d homography)
+{
+    std::lock_guard<std::mutex> lockGuard(camerasMutex);
+    if (cameraIndex >= 0 && cameraIndex < cameras.size()) {
+        cameras[cameraIndex].homography = homography;
+    }
+}
+
+void TrackingMerger::RemoveAdditionalCameras()
+{
+    std::lock_guard<std::mutex> lockGuard(camerasMutex);
+    cameras.resize(1);
+}
+
+bool TrackingMerger::Update()
+{
+    std::lock_guard<std::mutex> lockGuard(camerasMutex);
+
+    // Only merge when at least one camera has finished detecting a new frame
+    bool isNewData = false;
+    for (int i = 0; i < cameras.size(); i++) {
+        cameras[i].trackingData = cameras[i].markerDetection->GetTrackingData();
+        if (cameras[i].trackingData.sequenceNumber != cameras[i].lastSequenceNumber) {
+            cameras[i].lastSequenceNumber = cameras[i].trackingData.sequenceNumber;
+            isNewData = true;
+        }
+    }
+    if (!isNewData) {
+        return false;
+    }
+
+    const CameraInput& firstCamera = cameras[0];
+    if (cameras.size() == 1 && firstCamera.homography == cv::Matx33d::eye()) {
+        trackingData = firstCamera.trackingData;
+        return true;
+    }
+
+    // The frame number is from the first camera and the capture time is from the oldest
+    // frame, so the latency sent to clients is never less than the real one
+    unsigned int sequenceNumber = trackingData.sequenceNumber + 1;
+    trackingData = TrackingData();
+    trackingData.sequenceNumber = sequenceNumber;
+    trackingData.frameNumber = firstCamera.trackingData.frameNumber;
+    trackingData.captureTime = firstCamera.trackingData.captureTime;
+
+    std::map<int, float> markerDistances;
+    for (int i = 0; i < cameras.size(); i++) {
+        const TrackingData& cameraData = cameras[i].trackingData;
+        if (cameraData.captureTime.time_since_epoch().count() > 0 &&
+            (trackingData.captureTime.time_since_epoch().count() == 0 || cameraData.captureTime < trackingData.captureTime))
+        {
+            trackingData.captureTime = cameraData.captureTime;
+        }
+
+        for (auto iter = cameraData.markers.begin(); iter != cameraData.markers.end(); iter++) {
+            const MarkerData& markerData = iter->second;
+            float distance = cv::norm(cv::Point2f(markerData.center[0] - 0.5f, markerData.center[1] - 0.5f));
+            auto closest = markerDistances.find(markerData.id);
+            if (closest != markerDistances.end() && closest->second <= distance) {
+                continue;
+            }
+            markerDistances[markerData.id] = distance;
+            trackingData.markers[markerData.id] = TransformMarker(markerData, cameras[i].homography);
+        }
+    }
+
+    return true;
+}
+
+TrackingData TrackingMerger::GetTrackingData()
+{
+    std::lock_guard<std::mutex> lockGuard(camerasMutex);
+    return trackingData;
+}
+
+MarkerData TrackingMerger::TransformMarker(const MarkerData& markerData, const cv::Matx33d& homography)
+{
+    MarkerData tableMarkerData = markerData;
+    cv::Point2f center(markerData.center[0], markerData.center[1]);
+    cv::Point2f tableCenter = TransformPoint(homography, center);
+    tableMarkerData.center[0] = tableCenter.x;
+    tableMarkerData.center[1] = tableCenter.y;
+
+    float* corners[] = {tableMarkerData.topLeft, tableMarkerData.topRight,
+        tableMarkerData.bottomRight, tableMarkerData.bottomLeft};
+    for (int i = 0; i < 4; i++) {
+        cv::Point2f corner = TransformPoint(homography, cv::Point2f(corners[i][0], corners[i][1]));
+        corners[i][0] = corner.x;
+        corners[i][1] = corner.y;
+    }
+
+    // The angle and size change by the rotation and scale of the homography around the marker.
+    // The angle is counterclockwise and image rows go down, so a turn of the x axis is subtracted.
+    const float kStep = 0.001f;
+    cv::Point2f axisX = TransformPoint(homography, center + cv::Point2f(kStep, 0)) - tableCenter;
+    cv::Point2f axisY = TransformPoint(homography, center + cv::Point2f(0, kStep)) - tableCenter;
+    double angle = markerData.angle - kRadiansToDegrees * std::atan2(axisX.y, axisX.x);
+    tableMarkerData.angle = angle - 360 * std::floor((angle + 180) / 360);
+    tableMarkerData.size = markerData.size * std::abs(axisX.cross(axisY)) / (kStep * kStep);
+
+    return tableMarkerData;
+}
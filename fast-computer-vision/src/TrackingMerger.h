@@ -0,0 +1,62 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "MarkerDetection.h"
+#include "MarkerData.h"
+
+// Combines the markers from every camera into one normalized table space.
+// Each camera's marker coordinates go through its homography. A marker seen by more than one
+// camera is taken from the camera that sees it closest to the center of its image, where it
+// is the least likely to be cut off or distorted. With only the first camera and no homography
+// its tracking data passes through unchanged.
+class TrackingMerger
+{
+public:
+    TrackingMerger(MarkerDetection& markerDetection);
+    void AddCamera(MarkerDetection& markerDetection, cv::Matx33d homography);
+    void UpdateCameraHomography(int cameraIndex, cv::Matx33d homography);
+    void RemoveAdditionalCameras();
+    bool Update();
+    TrackingData GetTrackingData();
+
+private:
+    struct CameraInput
+    {
+        MarkerDetection* markerDetection;
+        cv::Matx33d homography;
+        unsigned int lastSequenceNumber = 0;
+        TrackingData trackingData;
+    };
+
+    static MarkerData TransformMarker(const MarkerData& markerData, const cv::Matx33d& homography);
+
+    std::vector<CameraInput> cameras;
+    TrackingData trackingData;
+    std::mutex camerasMutex;
+};
@@ -0,0 +1,441 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "V4L2FrameSource.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <linux/videodev2.h>
+
+// Enough buffers for detection and the window to each hold a few images
+static const unsigned int kNumBuffers = 8;
+static const int kGrabTimeoutMs = 1000;
+
+// Images are only kept past Release() while the driver still has this many buffers to fill
+static const int kMinQueuedBuffers = 2;
+
+// Retry any call that was interrupted by a signal
+static int RetryIoctl(int fileDescriptor, unsigned long request, void* argument)
+{
+    int result;
+    do {
+        result = ioctl(fileDescriptor, request, argument);
+    } while (result == -1 && errno == EINTR);
+    return result;
+}
+
+// Give a buffer back to the driver to fill
+static bool QueueDriverBuffer(int fileDescriptor, int index)
+{
+    v4l2_buffer buffer = {};
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = index;
+    if (RetryIoctl(fileDescriptor, VIDIOC_QBUF, &buffer) == -1) {
+        std::cout << "QueueBuffer() Error: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+V4L2FrameSource::BufferQueue::~BufferQueue()
+{
+    for (size_t i = 0; i < buffers.size(); i++) {
+        if (buffers[i].start != nullptr) {
+            munmap(buffers[i].start, buffers[i].length);
+        }
+    }
+}
+
+void V4L2FrameSource::BufferQueue::Requeue(int index)
+{
+    // Called from whichever thread lets go of the image last
+    std::lock_guard<std::mutex> lockGuard(queueMutex);
+    numHeldBuffers--;
+    if (fileDescriptor >= 0) {
+        QueueDriverBuffer(fileDescriptor, index);
+    }
+}
+
+V4L2FrameSource::V4L2FrameSource(std::string devicePath) :
+    devicePath(devicePath.empty() ? "/dev/video0" : devicePath),
+    fileDescriptor(-1),
+    isStreaming(false),
+    grabbedBufferIndex(-1),
+    bytesPerLine(0),
+    rawPixelFormat(RawPixelFormat::Unknown)
+{
+}
+
+V4L2FrameSource::~V4L2FrameSource()
+{
+    Close();
+}
+
+bool V4L2FrameSource::Open()
+{
+    fileDescriptor = open(devicePath.c_str(), O_RDWR | O_NONBLOCK);
+    if (fileDescriptor < 0) {
+        std::cout << "Open() Error: Unable to open " << devicePath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    v4l2_capability capability = {};
+    if (RetryIoctl(fileDescriptor, VIDIOC_QUERYCAP, &capability) == -1) {
+        std::cout << "Open() Error: " << devicePath << " is not a V4L2 device" << std::endl;
+        Close();
+        return false;
+    }
+    unsigned int deviceCapabilities = (capability.capabilities & V4L2_CAP_DEVICE_CAPS) ?
+        capability.device_caps : capability.capabilities;
+    if (!(deviceCapabilities & V4L2_CAP_VIDEO_CAPTURE) || !(deviceCapabilities & V4L2_CAP_STREAMING)) {
+        std::cout << "Open() Error: " << devicePath << " can't stream video" << std::endl;
+        Close();
+        return false;
+    }
+
+    std::cout << std::endl << "*** DEVICE INFORMATION ***" << std::endl << std::endl;
+    std::cout << "Device: " << capability.card << std::endl;
+    std::cout << "Driver: " << capability.driver << std::endl;
+
+    // GREY is already the grayscale image, and the Y samples of YUYV are too
+    if (!SetPixelFormat(V4L2_PIX_FMT_GREY) && !SetPixelFormat(V4L2_PIX_FMT_YUYV)) {
+        std::cout << "Open() Error: " << devicePath << " supports neither GREY nor YUYV" << std::endl;
+        Close();
+        return false;
+    }
+
+    // Map the driver's buffers so images can be read without copying them out of the kernel
+    v4l2_requestbuffers request = {};
+    request.count = kNumBuffers;
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    if (RetryIoctl(fileDescriptor, VIDIOC_REQBUFS, &request) == -1 || request.count < 2) {
+        std::cout << "Open() Error: Unable to request buffers: " << std::strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+
+    bufferQueue = std::make_shared<BufferQueue>();
+    bufferQueue->fileDescriptor = fileDescriptor;
+    bufferQueue->buffers.resize(request.count);
+    for (unsigned int i = 0; i < request.count; i++) {
+        v4l2_buffer buffer = {};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = i;
+        if (RetryIoctl(fileDescriptor, VIDIOC_QUERYBUF, &buffer) == -1) {
+            std::cout << "Open() Error: Unable to query buffer: " << std::strerror(errno) << std::endl;
+            Close();
+            return false;
+        }
+
+        void* start = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, buffer.m.offset);
+        if (start == MAP_FAILED) {
+            std::cout << "Open() Error: Unable to map buffer: " << std::strerror(errno) << std::endl;
+            Close();
+            return false;
+        }
+        bufferQueue->buffers[i].start = start;
+        bufferQueue->buffers[i].length = buffer.length;
+    }
+
+    sensorRegion = cv::Rect(cv::Point(0, 0), imageSize);
+    std::cout << "Pixel Format: " << ((rawPixelFormat == RawPixelFormat::Mono8) ? "GREY" : "YUYV") << std::endl;
+    std::cout << "Buffers: " << bufferQueue->buffers.size() << std::endl;
+
+    return true;
+}
+
+void V4L2FrameSource::Close()
+{
+    if (fileDescriptor < 0) {
+        return;
+    }
+
+    if (isStreaming) {
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        RetryIoctl(fileDescriptor, VIDIOC_STREAMOFF, &type);
+        isStreaming = false;
+    }
+    grabbedBufferIndex = -1;
+
+    // Buffers that images still hold are unmapped once they are let go of,
+    // and they aren't given back to the closed device
+    if (bufferQueue != nullptr) {
+        std::lock_guard<std::mutex> lockGuard(bufferQueue->queueMutex);
+        bufferQueue->fileDescriptor = -1;
+    }
+    bufferQueue.reset();
+
+    // Free the driver's buffers. The driver keeps any that are still mapped until they are unmapped.
+    v4l2_requestbuffers request = {};
+    request.count = 0;
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    RetryIoctl(fileDescriptor, VIDIOC_REQBUFS, &request);
+
+    close(fileDescriptor);
+    fileDescriptor = -1;
+}
+
+bool V4L2FrameSource::IsOpen()
+{
+    return fileDescriptor >= 0;
+}
+
+bool V4L2FrameSource::ConfigureReadoutMode(ReadoutMode readoutMode, SensorGeometry& sensorGeometry)
+{
+    if (readoutMode != ReadoutMode::Full) {
+        std::cout << "ConfigureReadoutMode() Binning and decimation are not available on V4L2 devices" << std::endl;
+    }
+
+    // Each pair of YUYV pixels shares its U and V samples, so regions start and end on a pair
+    int pixelIncrement = (rawPixelFormat == RawPixelFormat::YUYV) ? 2 : 1;
+    sensorGeometry.size = imageSize;
+    sensorGeometry.offsetIncrement = cv::Size(pixelIncrement, 1);
+    sensorGeometry.sizeIncrement = cv::Size(pixelIncrement, 1);
+    sensorGeometry.minimumSize = cv::Size(pixelIncrement, 1);
+    sensorRegion = cv::Rect(cv::Point(0, 0), imageSize);
+
+    return true;
+}
+
+bool V4L2FrameSource::ConfigureSensorRegion(cv::Rect region)
+{
+    // UVC cameras can't read out part of the sensor, but the region is still
+    // cropped out of the mapped buffer without copying it
+    sensorRegion = region & cv::Rect(cv::Point(0, 0), imageSize);
+    return true;
+}
+
+bool V4L2FrameSource::ConfigureGamma(double gamma)
+{
+    // Not every device has a gamma control, and those that do use gamma x 100
+    v4l2_queryctrl query = {};
+    query.id = V4L2_CID_GAMMA;
+    if (RetryIoctl(fileDescriptor, VIDIOC_QUERYCTRL, &query) == -1 || (query.flags & V4L2_CTRL_FLAG_DISABLED)) {
+        return true;
+    }
+
+    v4l2_control control = {};
+    control.id = V4L2_CID_GAMMA;
+    control.value = std::clamp((int)std::round(gamma * 100), query.minimum, query.maximum);
+    if (RetryIoctl(fileDescriptor, VIDIOC_S_CTRL, &control) == -1) {
+        std::cout << "ConfigureGamma() Error: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool V4L2FrameSource::ConfigureExposure(CameraExposure& exposure)
+{
+    // Exposure is set in units of 100 microseconds. Gain units differ from device to device,
+    // so gain is left alone and only the exposure time is controlled.
+    v4l2_queryctrl query = {};
+    query.id = V4L2_CID_EXPOSURE_ABSOLUTE;
+    if (RetryIoctl(fileDescriptor, VIDIOC_QUERYCTRL, &query) == -1 || (query.flags & V4L2_CTRL_FLAG_DISABLED)) {
+        return false;
+    }
+
+    // Not every device has auto exposure to turn off
+    v4l2_control control = {};
+    control.id = V4L2_CID_EXPOSURE_AUTO;
+    control.value = V4L2_EXPOSURE_MANUAL;
+    RetryIoctl(fileDescriptor, VIDIOC_S_CTRL, &control);
+
+    control.id = V4L2_CID_EXPOSURE_ABSOLUTE;
+    control.value = std::clamp((int)std::round(exposure.exposureTime / 100), query.minimum, query.maximum);
+    if (RetryIoctl(fileDescriptor, VIDIOC_S_CTRL, &control) == -1) {
+        std::cout << "ConfigureExposure() Error: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    exposure.exposureTime = control.value * 100.0;
+    exposure.gain = 0;
+    return true;
+}
+
+bool V4L2FrameSource::Grab(SourceImage& sourceImage, bool isGrayscale)
+{
+    // Begin streaming
+    // If streaming can't start the device is closed so it will be reopened.
+    if (!isStreaming) {
+        for (size_t i = 0; i < bufferQueue->buffers.size(); i++) {
+            if (!QueueBuffer(i)) {
+                Close();
+                return false;
+            }
+        }
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (RetryIoctl(fileDescriptor, VIDIOC_STREAMON, &type) == -1) {
+            std::cout << "Grab() Streaming Error: " << std::strerror(errno) << std::endl;
+            Close();
+            return false;
+        }
+        isStreaming = true;
+        std::cout << std::endl << std::endl << "*** CAMERA ACQUISITION ***" << std::endl << std::endl;
+        std::cout << "Acquiring images..." << std::endl;
+    }
+
+    // Wait for the driver to fill a buffer
+    pollfd pollDescriptor = {};
+    pollDescriptor.fd = fileDescriptor;
+    pollDescriptor.events = POLLIN;
+    int pollResult = poll(&pollDescriptor, 1, kGrabTimeoutMs);
+    if (pollResult == 0 || (pollResult < 0 && errno == EINTR)) {
+        return false;
+    }
+    if (pollResult < 0 || (pollDescriptor.revents & (POLLERR | POLLHUP))) {
+        std::cout << "Grab() Error: The device stopped responding" << std::endl;
+        Close();
+        return false;
+    }
+
+    // Take the newest filled buffer and give any older ones straight back to the driver
+    v4l2_buffer newestBuffer = {};
+    int newestIndex = -1;
+    while (true) {
+        v4l2_buffer buffer = {};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        if (RetryIoctl(fileDescriptor, VIDIOC_DQBUF, &buffer) == -1) {
+            if (errno == EAGAIN) {
+                break;
+            }
+            std::cout << "Grab() Image Error: " << std::strerror(errno) << std::endl;
+            if (newestIndex >= 0) {
+                QueueBuffer(newestIndex);
+            }
+            Close();
+            return false;
+        }
+        if (newestIndex >= 0) {
+            QueueBuffer(newestIndex);
+        }
+        newestIndex = buffer.index;
+        newestBuffer = buffer;
+    }
+    if (newestIndex < 0) {
+        return false;
+    }
+    grabbedBufferIndex = newestIndex;
+
+    // Skip incomplete images
+    if ((newestBuffer.flags & V4L2_BUF_FLAG_ERROR) || newestBuffer.bytesused < bytesPerLine * imageSize.height) {
+        sourceImage.isIncomplete = true;
+        Release();
+        return false;
+    }
+
+    // YUYV is converted to grayscale or color by the camera, so the buffer is handed out as it is
+    int imageType = (rawPixelFormat == RawPixelFormat::Mono8) ? CV_8UC1 : CV_8UC2;
+    void* bufferStart = bufferQueue->buffers[grabbedBufferIndex].start;
+    cv::Mat bufferImage(imageSize, imageType, bufferStart, bytesPerLine);
+    sourceImage.image = bufferImage(sensorRegion);
+    sourceImage.rawPixelFormat = rawPixelFormat;
+    sourceImage.frameId = newestBuffer.sequence;
+    sourceImage.timestamp = newestBuffer.timestamp.tv_sec * 1000000000LL + newestBuffer.timestamp.tv_usec * 1000LL;
+
+    // The image can be kept without copying it while the driver has enough other buffers to fill.
+    // Otherwise it goes back to the driver on Release() like before.
+    if ((int)bufferQueue->buffers.size() - bufferQueue->numHeldBuffers - 1 >= kMinQueuedBuffers) {
+        bufferQueue->numHeldBuffers++;
+        std::shared_ptr<BufferQueue> queue = bufferQueue;
+        int index = grabbedBufferIndex;
+        sourceImage.bufferOwner = std::shared_ptr<const void>(bufferStart,
+            [queue, index](const void*) { queue->Requeue(index); });
+        grabbedBufferIndex = -1;
+    }
+
+    return true;
+}
+
+void V4L2FrameSource::Release()
+{
+    if (grabbedBufferIndex >= 0) {
+        QueueBuffer(grabbedBufferIndex);
+        grabbedBufferIndex = -1;
+    }
+}
+
+bool V4L2FrameSource::SetPixelFormat(unsigned int pixelFormat)
+{
+    // Use the largest frame size the device offers in this format
+    cv::Size largestSize;
+    v4l2_frmsizeenum frameSize = {};
+    frameSize.pixel_format = pixelFormat;
+    for (frameSize.index = 0; RetryIoctl(fileDescriptor, VIDIOC_ENUM_FRAMESIZES, &frameSize) == 0; frameSize.index++) {
+        cv::Size size = (frameSize.type == V4L2_FRMSIZE_TYPE_DISCRETE) ?
+            cv::Size(frameSize.discrete.width, frameSize.discrete.height) :
+            cv::Size(frameSize.stepwise.max_width, frameSize.stepwise.max_height);
+        if (size.area() > largestSize.area()) {
+            largestSize = size;
+        }
+    }
+
+    v4l2_format format = {};
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (RetryIoctl(fileDescriptor, VIDIOC_G_FMT, &format) == -1) {
+        return false;
+    }
+    format.fmt.pix.pixelformat = pixelFormat;
+    format.fmt.pix.field = V4L2_FIELD_NONE;
+    if (!largestSize.empty()) {
+        format.fmt.pix.width = largestSize.width;
+        format.fmt.pix.height = largestSize.height;
+    }
+    if (RetryIoctl(fileDescriptor, VIDIOC_S_FMT, &format) == -1) {
+        return false;
+    }
+
+    // Drivers switch to a format they support instead of failing
+    if (format.fmt.pix.pixelformat != pixelFormat) {
+        return false;
+    }
+
+    rawPixelFormat = (pixelFormat == V4L2_PIX_FMT_GREY) ? RawPixelFormat::Mono8 : RawPixelFormat::YUYV;
+    imageSize = cv::Size(format.fmt.pix.width, format.fmt.pix.height);
+    bytesPerLine = format.fmt.pix.bytesperline;
+    if (bytesPerLine == 0) {
+        bytesPerLine = imageSize.width * ((rawPixelFormat == RawPixelFormat::Mono8) ? 1 : 2);
+    }
+
+    std::cout << "Image Size: " << imageSize.width << " x " << imageSize.height << std::endl;
+    return true;
+}
+
+bool V4L2FrameSource::QueueBuffer(int index)
+{
+    return QueueDriverBuffer(fileDescriptor, index);
+}
@@ -0,0 +1,89 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#pragma once
+#include "pch.h"
+#include "FrameSource.h"
+
+// Acquires images from a UVC camera or any other Video4Linux2 capture device on Linux.
+// The driver fills memory mapped buffers that are handed out without copying them,
+// GREY buffers as Mono8 and YUYV buffers as raw images whose Y samples are the grayscale image.
+// The newest filled buffer is always used and older ones go straight back to the driver.
+// A grabbed buffer can be kept past Release(), so a GREY image reaches detection without a copy.
+// It goes back to the driver when the last holder lets go of it, as long as enough buffers
+// are left for the driver to keep filling.
+class V4L2FrameSource : public FrameSource
+{
+public:
+    V4L2FrameSource(std::string devicePath);
+    ~V4L2FrameSource();
+
+    bool Open() override;
+    void Close() override;
+    bool IsOpen() override;
+
+    bool ConfigureReadoutMode(ReadoutMode readoutMode, SensorGeometry& sensorGeometry) override;
+    bool ConfigureSensorRegion(cv::Rect region) override;
+    bool ConfigureGamma(double gamma) override;
+    bool ConfigureExposure(CameraExposure& exposure) override;
+    bool Grab(SourceImage& sourceImage, bool isGrayscale) override;
+    void Release() override;
+
+private:
+    struct MappedBuffer
+    {
+        void* start = nullptr;
+        size_t length = 0;
+    };
+
+    // The mapped buffers outlive the frame source while images still use them. Buffers that
+    // come back after the device was closed are only unmapped.
+    struct BufferQueue
+    {
+        ~BufferQueue();
+        void Requeue(int index);
+
+        std::vector<MappedBuffer> buffers;
+        std::atomic<int> numHeldBuffers{0};
+        int fileDescriptor = -1;
+        std::mutex queueMutex;
+    };
+
+    bool SetPixelFormat(unsigned int pixelFormat);
+    bool QueueBuffer(int index);
+
+    std::string devicePath;
+    int fileDescriptor;
+    bool isStreaming;
+    std::shared_ptr<BufferQueue> bufferQueue;
+    int grabbedBufferIndex;
+
+    cv::Size imageSize;
+    size_t bytesPerLine;
+    RawPixelFormat rawPixelFormat;
+    cv::Rect sensorRegion;
+};
@@ -0,0 +1,105 @@
+//=============================================================================
+// FAST Computer Vision
+// A computer vision application to track ArUco markers.
+//
+// Copyright (C) 2024 Museum of Science, Boston
+// <https://www.mos.org/>
+//
+// This program was developed through a grant to the Museum of Science, Boston
+// from the Institute of Museum and Library Services under
+// Award #MG-249646-OMS-21. For more information about this grant, see
+// <https://www.imls.gov/grants/awarded/mg-249646-oms-21>.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see
+// <https://www.gnu.org/licenses/gpl-3.0.html>.
+//=============================================================================
+
+#include "VideoFrameSource.h"
+
+VideoFrameSource::VideoFrameSource(std::string path, FramePacing pacing, double frameRate) :
+    SoftwareFrameSource(pacing, frameRate),
+    path(path)
+{
+}
+
+VideoFrameSource::~VideoFrameSource()
+{
+    Close();
+}
+
+bool VideoFrameSource::Open()
+{
+    try {
+        if (!videoCapture.open(path)) {
+            std::cout << "Open() Error: Unable to open video " << path << std::endl;
+            return false;
+        }
+
+        // Use the frame rate of the video if it has one
+        double videoFrameRate = videoCapture.get(cv::CAP_PROP_FPS);
+        if (videoFrameRate > 0) {
+            frameRate = videoFrameRate;
+        }
+        imageSize = cv::Size(videoCapture.get(cv::CAP_PROP_FRAME_WIDTH), videoCapture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    }
+    catch (cv::Exception& exception) {
+        std::cout << "Open() Error: " << exception.what() << std::endl;
+        Close();
+        return false;
+    }
+
+    std::cout << "Video: " << path << ", " << imageSize.width << " x " << imageSize.height
+        << " at " << frameRate << " fps" << std::endl;
+    ResetPacing();
+    return true;
+}
+
+void VideoFrameSource::Close()
+{
+    videoCapture.release();
+}
+
+bool VideoFrameSource::IsOpen()
+{
+    return videoCapture.isOpened();
+}
+
+cv::Size VideoFrameSource::GetImageSize()
+{
+    return imageSize;
+}
+
+bool VideoFrameSource::ReadImage(SourceImage& sourceImage)
+{
+    try {
+        if (!videoCapture.read(videoImage)) {
+            // Start over at the end so the video can play for as long as it is needed
+            videoCapture.set(cv::CAP_PROP_POS_FRAMES, 0);
+            if (!videoCapture.read(videoImage)) {
+                std::cout << "ReadImage() Error: Unable to read video " << path << std::endl;
+                Close();
+                return false;
+            }
+        }
+    }
+    catch (cv::Exception& exception) {
+        std::cout << "ReadImage() Error: " << exception.what() << std::endl;
+        Close();
+        return false;
+    }
+
+    sourceImage.image = videoImage;
+    sourceImage.rawPixelFormat = (videoImage.channels() == 1) ? RawPixelFormat::Mono8 : RawPixelFormat::Unknown;
+    return true;
+}
@@ -27,6 +27,9 @@
 
 #include "calibration.h"
 
+// Spacing in pixels of the grid that single points are undistorted with
+static const int kUndistortPointMapStep = 8;
+
 Calibration::Calibration(Camera& camera) :
     camera(camera),
     isCaptureImage(false),
@@ -36,13 +39,14 @@ Calibration::Calibration(Camera& camera) :
     isCalibrated(false),
     currentFrameNumber(0),
     lastFrameNumber(0),
+    frameSequenceNumber(0),
     chessboardIntersections(24, 17),
     squareSize(1.0)
 {
-    camera.CopyImageTo(inputImage);
+    inputImage = cv::Mat::zeros(camera.GetResolution(), CV_8UC3);
     {
         std::lock_guard<std::mutex> lockGuard(outputImageMutex);
-        inputImage.copyTo(outputImage);
+        outputImage = inputImage;
     }
 }
 
@@ -57,15 +61,25 @@ void Calibration::Pause()
 
 void Calibration::Run()
 {
-    currentFrameNumber = camera.GetFrameNumber();
-    if (lastFrameNumber == currentFrameNumber) {
+    // The frame is shared with the camera and other stages, so it is only read and never copied
+    std::shared_ptr<const FrameData> inputFrame = camera.WaitForOutputFrame(frameSequenceNumber, 100);
+    if (inputFrame == nullptr) {
         return;
     }
+    currentFrameNumber = inputFrame->frameNumber;
 
-    camera.CopyImageTo(inputImage);
-
+    // The camera may already provide a grayscale image, in which case only
+    // the color image for drawing the checkerboard visualization is needed.
     cv::Mat grayInputImage;
-    cv::cvtColor(inputImage, grayInputImage, cv::COLOR_BGR2GRAY);
+    if (inputFrame->image.channels() == 1) {
+        grayInputImage = inputFrame->image;
+    }
+    else {
+        cv::cvtColor(inputFrame->image, grayInputImage, cv::COLOR_BGR2GRAY);
+    }
+
+    // Draw into a new image each time because the previous one is shared with the GUI
+    inputImage.release();
     cv::cvtColor(grayInputImage, inputImage, cv::COLOR_GRAY2BGR);
 
     std::vector<cv::Point2f> chessboardCorners;
@@ -116,7 +130,7 @@ void Calibration::Run()
 
     {
         std::lock_guard<std::mutex> lockGuard(outputImageMutex);
-        inputImage.copyTo(outputImage);
+        outputImage = inputImage;
     }
 
     lastFrameNumber = currentFrameNumber;
@@ -163,21 +177,15 @@ CalibrationLoadResult Calibration::LoadCalibration()
     }
 
     if (loadResult == CalibrationLoadResult::Succeeded) {
-        cv::initUndistortRectifyMap(
-            calibrationData.cameraMatrix,
-            calibrationData.distortionCoefficients, cv::Mat(),
-            cv::getOptimalNewCameraMatrix(
-                calibrationData.cameraMatrix,
-                calibrationData.distortionCoefficients,
-                imageSize, 1,
-                imageSize, 0),
-            imageSize, CV_16SC2,
-            calibrationData.distortMap, calibrationData.undistortMap);
+        calibrationData.imageSize = imageSize;
+        InitializeMaps(calibrationData, imageSize);
 
         calibrationData.type = CalibrationType::Saved;
         camera.Calibrate(calibrationData);
         camera.ToggleCalibration(true);
         isCalibrated = true;
+
+        emit CalibrationLoaded();
     }
 
     return loadResult;
@@ -191,7 +199,7 @@ CalibrationSaveResult Calibration::SaveCalibration()
     try {
         cv::FileStorage fileStorage("calibration.yml", cv::FileStorage::WRITE);
         if (fileStorage.isOpened()) {
-            fileStorage << "imageSize" << inputImage.size();
+            fileStorage << "imageSize" << calibrationData.imageSize;
             fileStorage << "cameraMatrix" << calibrationData.cameraMatrix;
             fileStorage << "distortionCoefficients" << calibrationData.distortionCoefficients;
         }
@@ -260,16 +268,8 @@ void Calibration::CalibrateCamera()
         calibrationData.cameraMatrix, calibrationData.distortionCoefficients,
         rotationMatrix, translationMatrix);
 
-    cv::initUndistortRectifyMap(
-        calibrationData.cameraMatrix,
-        calibrationData.distortionCoefficients, cv::Mat(),
-        cv::getOptimalNewCameraMatrix(
-            calibrationData.cameraMatrix,
-            calibrationData.distortionCoefficients,
-            inputImage.size(), 1,
-            inputImage.size(), 0),
-        inputImage.size(), CV_16SC2,
-        calibrationData.distortMap, calibrationData.undistortMap);
+    calibrationData.imageSize = inputImage.size();
+    InitializeMaps(calibrationData, inputImage.size());
 
     calibrationData.type = CalibrationType::Preview;
     camera.Calibrate(calibrationData);
@@ -277,6 +277,74 @@ void Calibration::CalibrateCamera()
     emit CalibrationDone(rmsError);
 }
 
+void Calibration::InitializeMaps(CalibrationData& calibrationData, cv::Size imageSize)
+{
+    // The camera matrix is scaled when the maps are for a different image size than the one
+    // that was calibrated, for example when the camera is binning or decimating pixels.
+    cv::Mat cameraMatrix = calibrationData.cameraMatrix.clone();
+    if (!calibrationData.imageSize.empty() && imageSize != calibrationData.imageSize) {
+        double scaleX = double(imageSize.width) / calibrationData.imageSize.width;
+        double scaleY = double(imageSize.height) / calibrationData.imageSize.height;
+        cameraMatrix.at<double>(0, 0) *= scaleX;
+        cameraMatrix.at<double>(1, 1) *= scaleY;
+        cameraMatrix.at<double>(0, 2) = (cameraMatrix.at<double>(0, 2) + 0.5) * scaleX - 0.5;
+        cameraMatrix.at<double>(1, 2) = (cameraMatrix.at<double>(1, 2) + 0.5) * scaleY - 0.5;
+    }
+
+    // Always build new maps because the previous ones may still be in use by the camera
+    calibrationData.distortMap.release();
+    calibrationData.undistortMap.release();
+    calibrationData.undistortPointMap.release();
+
+    cv::Mat newCameraMatrix = cv::getOptimalNewCameraMatrix(
+        cameraMatrix,
+        calibrationData.distortionCoefficients,
+        imageSize, 1,
+        imageSize, 0);
+
+    cv::initUndistortRectifyMap(
+        cameraMatrix,
+        calibrationData.distortionCoefficients, cv::Mat(),
+        newCameraMatrix,
+        imageSize, CV_16SC2,
+        calibrationData.distortMap, calibrationData.undistortMap);
+
+    // The point map inverts the same lens model on a grid of camera pixels. It reaches one step
+    // past the edges so every pixel has four grid points around it to interpolate between.
+    cv::Size gridSize(imageSize.width / kUndistortPointMapStep + 2, imageSize.height / kUndistortPointMapStep + 2);
+    std::vector<cv::Point2f> gridPoints;
+    gridPoints.reserve(gridSize.area());
+    for (int y = 0; y < gridSize.height; y++) {
+        for (int x = 0; x < gridSize.width; x++) {
+            gridPoints.push_back(cv::Point2f(x * kUndistortPointMapStep, y * kUndistortPointMapStep));
+        }
+    }
+
+    std::vector<cv::Point2f> undistortedPoints;
+    cv::undistortPoints(gridPoints, undistortedPoints,
+        cameraMatrix, calibrationData.distortionCoefficients, cv::noArray(), newCameraMatrix,
+        cv::TermCriteria(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, 20, 1e-6));
+    calibrationData.undistortPointMap = cv::Mat(undistortedPoints, true).reshape(2, gridSize.height);
+}
+
+cv::Point2f Calibration::UndistortPoint(const cv::Mat& undistortPointMap, cv::Point2f point)
+{
+    // Bilinear interpolation between the four grid points around the point.
+    // The grid is fine enough that this matches the remapped image well below a pixel.
+    float gridX = std::max(0.0f, point.x / kUndistortPointMapStep);
+    float gridY = std::max(0.0f, point.y / kUndistortPointMapStep);
+    int x = std::min((int)gridX, undistortPointMap.cols - 2);
+    int y = std::min((int)gridY, undistortPointMap.rows - 2);
+    float weightX = std::min(gridX - x, 1.0f);
+    float weightY = std::min(gridY - y, 1.0f);
+
+    const cv::Point2f* row0 = undistortPointMap.ptr<cv::Point2f>(y);
+    const cv::Point2f* row1 = undistortPointMap.ptr<cv::Point2f>(y + 1);
+    cv::Point2f top = row0[x] * (1 - weightX) + row0[x + 1] * weightX;
+    cv::Point2f bottom = row1[x] * (1 - weightX) + row1[x + 1] * weightX;
+    return top * (1 - weightY) + bottom * weightY;
+}
+
 void Calibration::ClearImages()
 {
     capturedCorners.clear();
@@ -291,8 +359,9 @@ bool Calibration::GetIsCalibrated()
 
 void Calibration::CopyImageTo(cv::Mat& destinationImage)
 {
+    // The output image is never drawn on again once it's published, so it can be shared without a copy
     std::lock_guard<std::mutex> lockGuard(outputImageMutex);
-    outputImage.copyTo(destinationImage);
+    destinationImage = outputImage;
 }
 
 double Calibration::GetFrameRate()
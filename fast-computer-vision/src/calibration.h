@@ -59,12 +59,16 @@ public:
 
     void UpdateCalibrationParameters(cv::Size chessboardIntersections, float squareSize);
 
+    static void InitializeMaps(CalibrationData& calibrationData, cv::Size imageSize);
+    static cv::Point2f UndistortPoint(const cv::Mat& undistortPointMap, cv::Point2f point);
+
 signals:
     void NumImagesChanged(int numImages);
     void MinimumImagesCaptured();
     void ComputeCalibrationProgress(int progress);
     void SaveCalibrationProgress(int progress);
     void CalibrationDone(double rmsError);
+    void CalibrationLoaded();
 
 
 private:
@@ -80,6 +84,7 @@ private:
 
     unsigned int currentFrameNumber;
     unsigned int lastFrameNumber;
+    unsigned int frameSequenceNumber;
 
     cv::Size chessboardIntersections;
     float squareSize;
@@ -26,11 +26,18 @@
 //=============================================================================
 
 #include "mainwindow.h"
+#include "Benchmark.h"
 
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+    // Measure the image processing without a camera or window
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        RunBenchmarks();
+        return 0;
+    }
+
     QApplication application(argc, argv);
     MainWindow window;
     window.show();
@@ -51,6 +51,11 @@ MainWindow::MainWindow(QWidget *parent)
     // UI updates
     connect(&manager.camera, &Camera::CameraConnected, this, &MainWindow::OnCameraConnected);
     connect(&manager.camera, &Camera::CameraDisconnected, this, &MainWindow::OnCameraDisconnected);
+    connect(&manager.camera, &Camera::ResolutionChanged, this, &MainWindow::OnCameraResolutionChanged);
+
+    // Save the flight recorder's recent images
+    QShortcut* dumpShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_D), this);
+    connect(dumpShortcut, &QShortcut::activated, this, &MainWindow::DumpFlightRecorder);
 
     // Basic Settings
     //
@@ -150,6 +155,7 @@ MainWindow::MainWindow(QWidget *parent)
     connect(&manager.calibration, &Calibration::NumImagesChanged, this, &MainWindow::UpdateImageCaptureProgress);
     connect(&manager.calibration, &Calibration::MinimumImagesCaptured, this, &MainWindow::EnableStep3Calibrate);
     connect(&manager.calibration, &Calibration::CalibrationDone, this, &MainWindow::EnableStep4ReviewAndSave);
+    connect(&manager.calibration, &Calibration::CalibrationLoaded, this, &MainWindow::OnCalibrationLoaded);
 
     // Calibration controls
     connect(ui->pushButton_captureImage, &QPushButton::pressed, this, &MainWindow::CaptureCalibrationImage);
@@ -197,9 +203,11 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->doubleSpinBox_checkerboardSquare, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
             this, &MainWindow::UpdateCalibrationParameters);
 
-    manager.calibration.LoadCalibration();
-    ui->checkBox_toggleCalibration->setEnabled(manager.calibration.GetIsCalibrated());
-    ui->checkBox_toggleCalibration->setChecked(manager.calibration.GetIsCalibrated());
+    // The calibration checkbox is enabled once the saved calibration has loaded in the background
+    ui->checkBox_toggleCalibration->setEnabled(false);
+    ui->checkBox_toggleCalibration->setChecked(false);
+    manager.startupTimer.Mark("Settings loaded");
+    manager.Start();
 
     ui->pushButton_saveSettings->setEnabled(false);
     ui->pushButton_loadSettings->setEnabled(false);
@@ -222,12 +230,28 @@ MainWindow::~MainWindow()
 }
 
 void MainWindow::OnCameraConnected()
+{
+    OnCameraResolutionChanged();
+}
+
+void MainWindow::OnCalibrationLoaded()
+{
+    ui->checkBox_toggleCalibration->setEnabled(manager.calibration.GetIsCalibrated());
+    ui->checkBox_toggleCalibration->setChecked(manager.calibration.GetIsCalibrated());
+}
+
+void MainWindow::OnCameraResolutionChanged()
 {
     cv::Size cameraResolution = manager.camera.GetResolution();
     ui->label_camera_resolution->setText(QString("%1 x %2").arg(
         QString::number(cameraResolution.width), QString::number(cameraResolution.height)));
 }
 
+void MainWindow::DumpFlightRecorder()
+{
+    manager.camera.GetFlightRecorder().RequestDump("Requested");
+}
+
 void MainWindow::OnCameraDisconnected()
 {
     ui->label_view_image->setText("Connecting to camera...");
@@ -237,7 +261,8 @@ void MainWindow::OnCameraDisconnected()
 void MainWindow::UpdateUi()
 {
     // Update camera view image
-    if (manager.camera.GetIsConnected()) {
+    // Skip it while the window is minimized so the preview doesn't cost anything when nobody can see it.
+    if (manager.camera.GetIsConnected() && !isMinimized()) {
         cv::Mat cameraImage;
         if (manager.GetMode() == AppMode::Tracking) {
             manager.markerDetection.CopyImageTo(cameraImage);
@@ -252,6 +277,14 @@ void MainWindow::UpdateUi()
             Qt::KeepAspectRatio, Qt::SmoothTransformation);
         ui->label_view_image->setPixmap(viewPixmap);
     }
+    else if (!manager.camera.GetIsConnected()) {
+        if (manager.camera.GetHealth() == CameraHealth::Stalled) {
+            ui->label_view_image->setText("Camera stopped sending images. Restarting...");
+        }
+        else {
+            ui->label_view_image->setText("Connecting to camera...");
+        }
+    }
 
     // Update framerates
     ui->label_camera_fps->setText(QString::number(manager.camera.GetFrameRate(), 'f', 1));
@@ -266,6 +299,28 @@ void MainWindow::UpdateUi()
     ui->label_network_fps->setText(QString::number(manager.networkCommunication.GetFrameRate(), 'f', 1));
     ui->label_ui_fps->setText(QString::number(frameRateTimer.frameRate, 'f', 1));
 
+    // Update frame drop counts, which are shown when hovering over the framerates
+    FrameStatistics frameStatistics = manager.GetFrameStatistics();
+    ui->label_camera_fps->setToolTip(QString(
+        "Frames received: %1\nDropped before arriving: %2\nIncomplete: %3\nSkipped: %4\nStalls: %5\nGaps: %6").arg(
+        QString::number(frameStatistics.camera.numFrames),
+        QString::number(frameStatistics.camera.numDropped),
+        QString::number(frameStatistics.numIncompleteImages),
+        QString::number(frameStatistics.numSkippedImages),
+        QString::number(frameStatistics.numStalls),
+        QString::fromStdString(FormatGapHistogram(frameStatistics.camera))));
+    ui->label_detection_fps->setToolTip(QString(
+        "Frames detected: %1\nCamera frames missed: %2\nGaps: %3\nSmallest marker found: %4 pixels").arg(
+        QString::number(frameStatistics.detection.numFrames),
+        QString::number(frameStatistics.detection.numDropped),
+        QString::fromStdString(FormatGapHistogram(frameStatistics.detection)),
+        QString::number(manager.markerDetection.GetMinMarkerSize())));
+    ui->label_network_fps->setToolTip(QString(
+        "Packets sent: %1\nDetection results missed: %2\nGaps: %3").arg(
+        QString::number(frameStatistics.network.numFrames),
+        QString::number(frameStatistics.network.numDropped),
+        QString::fromStdString(FormatGapHistogram(frameStatistics.network))));
+
     frameRateTimer.Update();
 }
 
@@ -276,11 +331,11 @@ void MainWindow::UpdateMode(int modeIndex)
 
     if (mode == AppMode::Tracking) {
         ui->label_mode->setText("Tracking Mode");
-        manager.camera.ToggleRotation(true);
+        manager.camera.ToggleSensorRegion(true);
     }
     else if (mode == AppMode::Calibration) {
         ui->label_mode->setText("Calibration Mode");
-        manager.camera.ToggleRotation(false);
+        manager.camera.ToggleSensorRegion(false);
     }
 }
 
@@ -335,13 +390,49 @@ void MainWindow::UpdateCameraParameters()
     double gamma = ui->doubleSpinBox_gamma->value();
     manager.camera.UpdateGamma(gamma);
 
-    bool isRotate = ui->radioButton_rotate180->isChecked();
-    manager.camera.UpdateRotation(isRotate);
+    manager.markerDetection.UpdateOrientation(GetOrientationData());
 
     ui->pushButton_saveSettings->setEnabled(true);
     ui->pushButton_loadSettings->setEnabled(true);
 }
 
+OrientationData MainWindow::GetOrientationData()
+{
+    // The rotation from the window is added to the rotation from settings.xml
+    OrientationData orientationData;
+    int rotation = settings.orientationRotation + (ui->radioButton_rotate180->isChecked() ? 180 : 0);
+    orientationData.rotation = (OrientationRotation)((((rotation / 90) % 4) + 4) % 4);
+    orientationData.isMirrored = settings.orientationMirror;
+
+    // The affine transform is six numbers, the first two rows of the matrix
+    QStringList substrings = settings.orientationAffine.split(" ", Qt::SkipEmptyParts);
+    if (substrings.size() == 6) {
+        cv::Matx23d affine;
+        for (int i = 0; i < 6; i++) {
+            affine.val[i] = substrings[i].toDouble();
+        }
+        if (std::abs(cv::determinant(affine.get_minor<2, 2>(0, 0))) > 1e-6) {
+            orientationData.affine = affine;
+        }
+    }
+
+    return orientationData;
+}
+
+cv::Matx33d MainWindow::ParseHomography(QString text)
+{
+    // Nine numbers, the matrix row by row. Anything else leaves the coordinates as they are.
+    cv::Matx33d homography = cv::Matx33d::eye();
+    QStringList substrings = text.split(" ", Qt::SkipEmptyParts);
+    if (substrings.size() == 9) {
+        for (int i = 0; i < 9; i++) {
+            homography.val[i] = substrings[i].toDouble();
+        }
+    }
+
+    return homography;
+}
+
 void MainWindow::UpdateCalibrationParameters()
 {
     double squareSize = ui->doubleSpinBox_checkerboardSquare->value();
@@ -390,7 +481,7 @@ void MainWindow::UpdateDetectorParameters()
     detectorParameters.maxErroneousBitsInBorderRate = ui->doubleSpinBox_maxErroneousBitsInBorderRate->value();
     detectorParameters.errorCorrectionRate = ui->doubleSpinBox_errorCorrectionRate->value();
 
-    manager.markerDetection.UpdateDetectorParameters(detectorParameters);
+    manager.UpdateDetectorParameters(detectorParameters);
 
     ui->pushButton_saveSettings->setEnabled(true);
     ui->pushButton_loadSettings->setEnabled(true);
@@ -478,6 +569,57 @@ void MainWindow::LoadSettings()
     ui->doubleSpinBox_maxErroneousBitsInBorderRate->setValue(settings.maxErroneousBitsInBorderRate);
     ui->doubleSpinBox_errorCorrectionRate->setValue(settings.errorCorrectionRate);
 
+    // Performance settings are only available in settings.xml
+    manager.camera.ToggleGrayscale(settings.grayscale);
+    manager.camera.UpdateUseSensorRegion(settings.useSensorRegion);
+    manager.camera.UpdateReadoutMode((ReadoutMode)settings.readoutMode);
+    manager.camera.TogglePointUndistortion(settings.pointUndistortion);
+    manager.camera.GetFlightRecorder().UpdateDuration(settings.flightRecorderSeconds);
+    manager.camera.GetFlightRecorder().UpdateMemoryLimit(settings.flightRecorderMemory);
+    manager.camera.GetFlightRecorder().ToggleAutoDump(settings.flightRecorderAutoDump);
+    manager.camera.UpdateStallTimeout(settings.stallTimeout);
+    manager.camera.GetExposureController().UpdateLimits(settings.autoExposureMaxTime, settings.autoExposureMaxGain);
+    manager.camera.GetExposureController().UpdateTargetContrast(settings.autoExposureContrast);
+    manager.camera.GetExposureController().ToggleAutoExposure(settings.autoExposure);
+    manager.markerDetection.UpdateFullScanInterval(settings.fullScanInterval);
+    manager.markerDetection.ToggleRoiTracking(settings.roiTracking);
+    manager.markerDetection.UpdatePyramidLevel(settings.pyramidLevel);
+    manager.markerDetection.UpdateTileMarkerSize(settings.tileMarkerSize);
+    manager.markerDetection.UpdateDetectionWorkers(settings.detectionWorkers, settings.detectionQueueDepth);
+
+    // Orientation settings are only available in settings.xml
+    manager.markerDetection.UpdateOrientation(GetOrientationData());
+
+    // Frame source settings are only available in settings.xml
+    FrameSourceData frameSourceData;
+    frameSourceData.type = (FrameSourceType)settings.frameSource;
+    frameSourceData.path = settings.frameSourcePath.toStdString();
+    frameSourceData.pacing = (FramePacing)settings.framePacing;
+    frameSourceData.frameRate = settings.frameSourceFrameRate;
+    frameSourceData.markerDictionarySize = settings.markerDictionarySize;
+    frameSourceData.markerNumBits = settings.markerNumBits;
+    frameSourceData.isSyntheticBayer = settings.syntheticBayer;
+    frameSourceData.serialNumber = settings.cameraSerialNumber.toStdString();
+
+    // Multi-camera settings are only available in settings.xml
+    // Each additional camera is its serial number followed by the nine numbers of its homography.
+    // Without a serial number the first camera skips the additional cameras.
+    std::vector<CameraPipelineData> additionalCameras;
+    for (int i = 0; i < settings.additionalCameras.size(); i++) {
+        QStringList substrings = settings.additionalCameras[i].split(" ", Qt::SkipEmptyParts);
+        if (substrings.isEmpty()) {
+            continue;
+        }
+        CameraPipelineData cameraPipelineData;
+        cameraPipelineData.serialNumber = substrings.takeFirst().toStdString();
+        cameraPipelineData.homography = ParseHomography(substrings.join(" "));
+        additionalCameras.push_back(cameraPipelineData);
+        frameSourceData.otherSerialNumbers.push_back(cameraPipelineData.serialNumber);
+    }
+    manager.camera.UpdateFrameSource(frameSourceData);
+    manager.UpdateCameraHomography(ParseHomography(settings.cameraHomography));
+    manager.UpdateAdditionalCameras(frameSourceData, additionalCameras);
+
     ui->pushButton_saveSettings->setEnabled(false);
     ui->pushButton_loadSettings->setEnabled(false);
 }
@@ -38,6 +38,7 @@
 #include <QDir>
 #include <QDesktopServices>
 #include <QMessageBox>
+#include <QShortcut>
 #include "pch.h"
 #include "MarkdownViewerWindow.h"
 #include "AppManager.h"
@@ -66,10 +67,16 @@ private:
     FrameRateTimer frameRateTimer;
     QTimer timer;
 
+    OrientationData GetOrientationData();
+    cv::Matx33d ParseHomography(QString text);
+
 private slots:
     void UpdateUi();
     void OnCameraConnected();
     void OnCameraDisconnected();
+    void OnCameraResolutionChanged();
+    void OnCalibrationLoaded();
+    void DumpFlightRecorder();
 
     void UpdateMode(int modeIndex);
     void UpdateWindowParameters();
@@ -26,15 +26,19 @@
 //=============================================================================
 
 #pragma once
+#ifdef _WIN32
 #include <windows.h>
 #include <unknwn.h>
 #include <restrictederrorinfo.h>
 #include <hstring.h>
 
 #include <ppltasks.h>
+#endif
 
+#ifdef USE_SPINNAKER
 #include "Spinnaker.h"
 #include "SpinGenApi/SpinnakerGenApi.h"
+#endif
 #include <opencv2/opencv.hpp>
 #include <opencv2/aruco.hpp>
 #include <opencv2/xphoto.hpp>
@@ -50,10 +54,12 @@
 #include <algorithm>
 #include <cctype>
 #include <thread>
+#include <atomic>
+#include <array>
 
-const double kImageWidth = 3072;
-const double kImageHeight = 2048;
-const double kWindowWidth = kImageWidth * 0.5;
-const double kWindowHeight = kImageHeight * 0.5;
+// The image size before a camera is connected.
+// Once connected, the image size follows the camera's sensor and readout mode.
+const double kDefaultImageWidth = 3072;
+const double kDefaultImageHeight = 2048;
 
 const double kRadiansToDegrees = 180.0 / 3.141592653589793238463;